@@ -1,101 +1,55 @@
 #include <opencv2/opencv.hpp>
 #include "./reusables/utils.h"
+#include "./reusables/edges.h"
+#include "./reusables/hough.h"
 #include <iostream>
 
-cv::Mat hough_lines(cv::Mat & input, int houghTH, int cannyTHL, int cannyTHH, int blurSize = 3, float blurSigma = 0.5) {
+cv::Mat hough_lines(cv::Mat & input, int houghTH, int cannyTHL, int cannyTHH, int blurSize = 3, float blurSigma = 0.5, int numTheta = 180) {
     cv::Mat img = input.clone();
 
-    // Blurring and Canny
+    // Blurring and Canny (edge pixels only)
     cv::GaussianBlur(img, img, cv::Size(blurSize, blurSize), blurSigma, blurSigma);
-    cv::Canny(img, img, cannyTHL, cannyTHH);
-
-    // Accumulator
-    int diagLen = std::ceil(std::hypot(img.rows, img.cols));
-    int maxTheta = 180;
-    cv::Mat votes = cv::Mat::zeros(diagLen * 2, maxTheta, CV_8U);
-
-    // Calculating votes
-    for (int x = 0; x < img.rows; ++x) {
-        for (int y = 0; y < img.cols; ++y) {
-            if (img.at<uchar>(x, y) == 255) {
-                for (int theta = 0; theta < maxTheta; ++theta) {
-                    int rho = (int) std::ceil((y * std::cos(theta) + x * std::sin(theta))) + diagLen;
-                    votes.at<uchar>(rho, theta)++;
-                }
-            }
-        }
-    }
-
-    // Drawing lines
-    int alpha = 1000;
-    int x0, y0;
-    cv::Point p1, p2;
-    cv::Mat out = input.clone();
-    for (int rhoIdx = 0; rhoIdx < votes.rows; ++rhoIdx) {
-        for (int theta = 0; theta < votes.cols; ++theta) {
-            if (votes.at<uchar>(rhoIdx, theta) >= houghTH) {
-                int rho = rhoIdx - diagLen;
-
-                x0 = cvRound(rho * std::cos(theta));
-                y0 = cvRound(rho * std::sin(theta));
+    std::vector<EdgePoint> edges;
+    cannyEdgePoints(img, cannyTHL, cannyTHH, edges);
 
-                p1.x = cvRound(x0 + alpha * (-std::sin(theta)));
-                p1.y = cvRound(y0 + alpha * std::cos(theta));
+    // Accumulator (theta-major, fixed point sin/cos tables, 16/32 bit counters), theta slices voted in parallel
+    HoughTrigTable trig = houghTrigTable(numTheta);
+    cv::Mat votes;
+    houghVoteLines(edges, img.size(), trig, votes, cv::getNumThreads());
 
-                p2.x = cvRound(x0 - alpha * (-std::sin(theta)));
-                p2.y = cvRound(y0 - alpha * std::cos(theta));
-
-                cv::line(out, p1, p2, cv::Scalar(0, 0, 255), 2, cv::LINE_AA);
-            }
-        }
-    }
+    // Peaks (3x3 non-maximum suppression in the accumulator) and drawing
+    std::vector<HoughLine> lines = houghLinePeaks(votes, houghTH, 1);
+    cv::Mat out = input.clone();
+    houghDrawLines(out, lines, cv::Scalar(0, 0, 255), 2, cv::LINE_AA);
 
     return out;
 }
 
-cv::Mat hough_circles(cv::Mat & input, int houghTH, int radMin, int radMax, int cannyTHL, int cannyTHH, int blurSize = 3, float blurSigma = 0.5) {
+cv::Mat hough_circles(cv::Mat & input, double houghTH, int radMin, int radMax, int cannyTHL, int cannyTHH, int blurSize = 3, float blurSigma = 0.5) {
     cv::Mat img = input.clone();
 
-    // Blurring and Canny
+    // Blurring and Canny (edge pixels only)
     cv::GaussianBlur(img, img, cv::Size(blurSize, blurSize), blurSigma, blurSigma);
-    cv::Canny(img, img, cannyTHL, cannyTHH);
-
-    // Accumulator
-    int radiusOffset = radMax - radMin + 1;
-    int sizes[] = {img.rows, img.cols, radiusOffset};
-    cv::Mat votes = cv::Mat(3, sizes, CV_8U, cv::Scalar(0));
-
-    // Calculating votes
-    for (int x = 0; x < img.rows; ++x) {
-        for (int y = 0; y < img.cols; ++y) {
-            if (img.at<uchar>(x, y) == 255) {
-                for (int radius = radMin; radius < radMax; ++radius) {
-                    for (int thetaDeg = 0; thetaDeg < 360; ++thetaDeg) {
-                        double thetaRad = thetaDeg * CV_PI / 180;
-
-                        int alpha = x - radius * std::cos(thetaRad);
-                        int beta = y - radius * std::sin(thetaRad);
-
-                        if (alpha >= 0 and alpha < img.rows and beta >= 0 and beta < img.cols) {
-                            votes.at<uchar>(alpha, beta, radius - radMin)++;
-                        }
-                    }
-                }
-            }
-        }
+    std::vector<EdgePoint> edges;
+    cannyEdgePoints(img, cannyTHL, cannyTHH, edges);
+
+    // Votes in bands of 2D slices (one per radius, cached midpoint circle offsets, radMax included),
+    // peaks over houghTH of the ring of each radius, then duplicates at adjacent radii removed
+    std::vector<HoughCircle> circles;
+    cv::Mat votes;
+    int band = cv::getNumThreads();
+    for (int radius = radMin; radius <= radMax; radius += band) {
+        int numRadii = std::min(band, radMax - radius + 1);
+        houghVoteCircles(edges, img.size(), radius, numRadii, votes);
+        houghCirclePeaksFraction(votes, img.size(), radius, houghTH, circles);
     }
+    houghSuppressCircles(circles, 1, 1);
 
     // Drawing circles
     cv::Mat out = input.clone();
-    for (int radius = radMin; radius < radMax; ++radius) {
-        for (int alpha = 0; alpha < img.rows; ++alpha) {
-            for (int beta = 0; beta < img.cols; ++beta) {
-                if (votes.at<uchar>(alpha, beta, radius - radMin) > houghTH) {
-                    cv::circle(out, cv::Point(beta, alpha), 2, cv::Scalar(0), 2, 8, 0);
-                    cv::circle(out, cv::Point(beta, alpha), radius, cv::Scalar(0), 2, 8, 0);
-                }
-            }
-        }
+    for (const HoughCircle & c : circles) {
+        cv::circle(out, c.center, 2, cv::Scalar(0), 2, 8, 0);
+        cv::circle(out, c.center, c.radius, cv::Scalar(0), 2, 8, 0);
     }
 
     return out;
@@ -103,7 +57,7 @@ cv::Mat hough_circles(cv::Mat & input, int houghTH, int radMin, int radMax, int
 
 int main(int argc, char ** argv) {
     // Test Hough Lines
-    cv::Mat inputImg = imreadWrapper(argc, argv, cv::IMREAD_GRAYSCALE);
+    cv::Mat inputImg = imreadWrapper(argc, argv, cv::IMREAD_COLOR);
     imshowWrapper("inputImg" ,inputImg);
 
     int houghTH_l = 150;
@@ -118,10 +72,10 @@ int main(int argc, char ** argv) {
 
     // Test Hough Circles
     argv[1] = argv[2];
-    cv::Mat inputImg2 = imreadWrapper(argc, argv, cv::IMREAD_GRAYSCALE);
+    cv::Mat inputImg2 = imreadWrapper(argc, argv, cv::IMREAD_COLOR);
     imshowWrapper("inputImg2", inputImg2);
 
-    int houghTH_c = 190;
+    double houghTH_c = 0.5; // fraction of the circle
     int radMin_c = 20;
     int radMax_c = 70;
     int cannyLTH_c  = 40;
@@ -1,104 +1,120 @@
 #include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <vector>
 #include "../reusables/utils.h"
+#include "../reusables/edges.h"
+
+/**
+ * Runs blur, gradient and non-maximum suppression on the rows [rowBegin, rowEnd) of an image.
+ *
+ * The band is read together with a halo of rows on each side: the blur radius, plus one row for the
+ * gradient and one for the suppression. The band never needs data computed by other bands, and its rows
+ * come out exactly as if the whole image had been processed at once.
+ *
+ * @param input     Input image (grayscale or BGR).
+ * @param nms       Output thinned magnitude (CV_16U, full image size). Only the band rows are written.
+ * @param dir       Output direction codes (CV_8U, full image size), written like nms unless it is empty.
+ * @param rowBegin  First row of the band.
+ * @param rowEnd    One past the last row of the band.
+ * @param blurSize  Size of the Gaussian filter kernel.
+ * @param blurSigma Standard deviation for Gaussian blur.
+ * @param minMag    Smallest gradient magnitude found in the band.
+ * @param maxMag    Largest gradient magnitude found in the band.
+ */
+void cannyBand(const cv::Mat & input, cv::Mat & nms, cv::Mat & dir, int rowBegin, int rowEnd, int blurSize, float blurSigma, int & minMag, int & maxMag) {
+    int gradientBegin = std::max(rowBegin - 1, 0);
+    int gradientEnd = std::min(rowEnd + 1, input.rows);
+    int haloBegin = std::max(rowBegin - 2 - blurSize / 2, 0);
+    int haloEnd = std::min(rowEnd + 2 + blurSize / 2, input.rows);
+
+    // Step 1: Apply Gaussian blur to reduce noise.
+    // BORDER_ISOLATED reflects at the halo edges instead of reading outside the band: that only alters
+    // halo rows that are not used below, except at the image edges, where it matches the full-frame blur.
+    cv::Mat blurredImg;
+    cv::GaussianBlur(input.rowRange(haloBegin, haloEnd), blurredImg, cv::Size(blurSize, blurSize), blurSigma, blurSigma, cv::BORDER_DEFAULT | cv::BORDER_ISOLATED);
+
+    // Step 2: Compute L1 magnitude and quantized direction in a single pass, one halo row on each side.
+    cv::Mat magnitude, direction;
+    cannyGradient(blurredImg, gradientBegin - haloBegin, gradientEnd - haloBegin, magnitude, direction, minMag, maxMag);
+
+    // Step 3: Non-maximum suppression to retain local maximum gradient values.
+    cannyNonMaxSuppression(magnitude, direction, gradientBegin, nms, rowBegin, rowEnd);
+
+    if (not dir.empty()) {
+        cv::Mat bandDir = dir.rowRange(rowBegin, rowEnd);
+        direction.rowRange(rowBegin - gradientBegin, rowEnd - gradientBegin).copyTo(bandDir);
+    }
+}
 
 /**
  * Applies the Canny edge detection algorithm to an input image.
  *
  * This function performs the following steps:
  * 1. Gaussian blur to reduce noise.
- * 2. Gradient computation, including magnitude and phase.
+ * 2. Gradient computation: L1 magnitude and direction quantized to 4 bins, in a single pass.
  * 3. Non-maximum suppression to retain local maximum gradient values.
- * 4. Hysteresis thresholding to identify edges based on high and low threshold values.
+ * 4. Hysteresis thresholding: strong pixels and the weak pixels connected to them are edges.
  *
- * @param input     Input image (grayscale).
+ * On BGR images the gradient of each channel is computed in the same pass, and each pixel keeps the
+ * channel with the largest gradient, so chroma edges are not lost to a grayscale conversion.
+ *
+ * Steps 1-3 run independently on horizontal bands of the image (see cannyBand), in parallel on
+ * OpenCV's thread pool when numBands > 1. The result does not depend on the number of bands.
+ *
+ * @param input     Input image (grayscale or BGR).
  * @param cannyTHL  Lower threshold for hysteresis thresholding.
  * @param cannyTHH  Upper threshold for hysteresis thresholding.
  * @param blurSize  Size of the Gaussian filter kernel (default is 3).
  * @param blurSigma Standard deviation for Gaussian blur (default is 0.5).
+ * @param numBands  Number of horizontal bands processed in parallel (default is 1, single-threaded).
+ * @param edgeList  Optional output list of the edge pixels in scan order, with gradient direction and magnitude.
  *
  * @return Binary image with detected edges (edge pixels set to 255, others to 0).
  */
-cv::Mat canny(cv::Mat & input, int cannyTHL, int cannyTHH, int blurSize = 3, float blurSigma = 0.5) {
-    cv::Mat img = input.clone();
-
-    // Step 1: Apply Gaussian blur to reduce noise.
-    cv::GaussianBlur(img, img, cv::Size(blurSize, blurSize), blurSigma, blurSigma);
-
-    // Step 2: Compute gradient, magnitude, and phase.
-    cv::Mat x_gradient, y_gradient;
-    cv::Sobel(img, x_gradient, CV_32F, 1, 0 );
-    cv::Sobel(img, y_gradient, CV_32F, 0, 1);
-
-    cv::Mat magnitude = cv::abs(x_gradient) + cv::abs(y_gradient);
-    cv::normalize(magnitude, magnitude, 0, 255, cv::NORM_MINMAX, CV_8U);
-
-    cv::Mat phase;
-    cv::phase(x_gradient, y_gradient, phase);
+cv::Mat canny(cv::Mat & input, int cannyTHL, int cannyTHH, int blurSize = 3, float blurSigma = 0.5, int numBands = 1, std::vector<EdgePoint> * edgeList = nullptr) {
+    numBands = std::max(1, std::min(numBands, input.rows));
 
-    // Step 3: Non-maximum suppression to retain local maximum gradient values.
-    cv::Mat nonMaximaSuppressed = magnitude.clone();
-    uchar pixel1, pixel2;
-    for (int y = 1; y < magnitude.rows - 1; ++y) {
-        for (int x = 1; x < magnitude.cols - 1; ++x) {
-            float angle = phase.at<float>(cv::Point(x, y));
-
-            if ((angle >= 360-22.5 and angle <= 22.5)
-            or (angle >= 360-22.5+180 and angle <= 22.5+180)) {
-                pixel1 = magnitude.at<uchar>(cv::Point(x + 1, y));
-                pixel2 = magnitude.at<uchar>(cv::Point(x - 1, y));
-            }
-            else if ((angle >= 22.5 and angle <= 22.5+45)
-            or (angle >= 22.5+180 and angle <= 22.5+45+180)) {
-                pixel1 = magnitude.at<uchar>(cv::Point(x - 1, y + 1));
-                pixel2 = magnitude.at<uchar>(cv::Point(x + 1, y - 1));
-            }
-            else if ((angle >= 22.5+45 and angle <= 22.5+90)
-            or (angle >= 22.5+45+180 and angle <= 22.5+90+180)) {
-                pixel1 = magnitude.at<uchar>(cv::Point(x + 1, y));
-                pixel2 = magnitude.at<uchar>(cv::Point(x - 1, y));
-            }
-            else {
-                pixel1 = magnitude.at<uchar>(cv::Point(x + 1, y - 1));
-                pixel2 = magnitude.at<uchar>(cv::Point(x - 1, y + 1));
-            }
-
-            uchar currentMagnitude = magnitude.at<uchar>(cv::Point(x, y));
-            if (currentMagnitude < pixel1 or currentMagnitude < pixel2)
-                nonMaximaSuppressed.at<uchar>(cv::Point(x, y)) = 0;
+    // Steps 1-3: Blur, gradient and non-maximum suppression, band by band.
+    cv::Mat nonMaximaSuppressed(input.rows, input.cols, CV_16U);
+    cv::Mat direction;
+    if (edgeList != nullptr)
+        direction.create(input.rows, input.cols, CV_8U);
+    std::vector<int> bandMinMagnitude(numBands), bandMaxMagnitude(numBands);
+    cv::parallel_for_(cv::Range(0, numBands), [&](const cv::Range & range) {
+        for (int band = range.start; band < range.end; ++band) {
+            int rowBegin = input.rows * band / numBands;
+            int rowEnd = input.rows * (band + 1) / numBands;
+            cannyBand(input, nonMaximaSuppressed, direction, rowBegin, rowEnd, blurSize, blurSigma, bandMinMagnitude.at(band), bandMaxMagnitude.at(band));
         }
-    }
+    });
+    int minMagnitude = *std::min_element(bandMinMagnitude.begin(), bandMinMagnitude.end());
+    int maxMagnitude = *std::max_element(bandMaxMagnitude.begin(), bandMaxMagnitude.end());
 
-    // Step 4: Hysteresis thresholding to identify edges.
-    cv::Mat edgesImg = cv::Mat::zeros(nonMaximaSuppressed.rows, nonMaximaSuppressed.cols, nonMaximaSuppressed.type());
-    for (int y = 0; y < nonMaximaSuppressed.rows; ++y) {
-        for (int x = 0; x < nonMaximaSuppressed.cols; ++x) {
-            if (nonMaximaSuppressed.at<uchar>(cv::Point(x, y)) > cannyTHH) {
-                edgesImg.at<uchar>(cv::Point(x, y)) = 255;
+    // The thresholds refer to the magnitude normalized to [0, 255]: map them to raw magnitudes instead.
+    int rawTHL = cannyRawThreshold(cannyTHL, minMagnitude, maxMagnitude);
+    int rawTHH = cannyRawThreshold(cannyTHH, minMagnitude, maxMagnitude);
 
-                // Define a region of interest (ROI) for local thresholding.
-                cv::Rect regionOfInterest(x - 1, y - 1, 3, 3);
-                for (int roi_y = regionOfInterest.y; roi_y < regionOfInterest.y + regionOfInterest.height; ++roi_y) {
-                    for (int roi_x = regionOfInterest.x; roi_x < regionOfInterest.x + regionOfInterest.width ; ++roi_x) {
-                        if (nonMaximaSuppressed.at<uchar>(cv::Point(roi_x, roi_y)) > cannyTHL and nonMaximaSuppressed.at<uchar>(cv::Point(roi_x, roi_y)) < cannyTHH)
-                            edgesImg.at<uchar>(cv::Point(roi_x, roi_y)) = 255;
-                    }
-                }
-            }
-        }
-    }
+    // Step 4: Hysteresis thresholding to identify edges (weak pixels connected to strong ones).
+    cv::Mat edgesImg;
+    if (numBands > 1)
+        cannyHysteresisParallel(nonMaximaSuppressed, rawTHL, rawTHH, edgesImg, numBands, edgeList, direction);
+    else
+        cannyHysteresis(nonMaximaSuppressed, rawTHL, rawTHH, edgesImg, edgeList, direction);
 
     return edgesImg;
 }
 
 int main(int argc, char ** argv) {
-    cv::Mat inputImg = imreadWrapper(argc, argv, cv::IMREAD_GRAYSCALE);
+    cv::Mat inputImg = imreadWrapper(argc, argv, cv::IMREAD_COLOR);
     imshowWrapper("Input Img", inputImg);
 
     int cannyTHL = 5;
     int cannyTHH = 20;
     int blurSize = 21;
+    float blurSigma = 0.5;
+    int numBands = cv::getNumThreads();
 
-    cv::Mat cannyImg = canny(inputImg, cannyTHL, cannyTHH, blurSize);
+    cv::Mat cannyImg = canny(inputImg, cannyTHL, cannyTHH, blurSize, blurSigma, numBands);
     imshowWrapper("Canny Img", cannyImg);
     return 0;
 }
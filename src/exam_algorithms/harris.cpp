@@ -1,8 +1,10 @@
 #include <opencv2/opencv.hpp>
+#include <vector>
 #include "../reusables/utils.h"
+#include "../reusables/harris.h"
 
 /**
- * Applies the Harris Corner Detector algorithm to an input image.
+ * Detects corners with the Harris Corner Detector algorithm.
  *
  * This function performs the following steps:
  * 1. Compute the horizontal and vertical derivatives using Sobel operators.
@@ -10,67 +12,147 @@
  * 3. Apply Gaussian smoothing to the derivative images.
  * 4. Compute the elements of the structure tensor.
  * 5. Compute the Harris response function R.
- * 6. Apply a threshold to detect corners.
- * 7. Draw circles on the input image at detected corner locations.
+ * Steps 1-5 are fused in a single row-by-row pass (see harrisResponse), without full-size temporaries.
+ * 6. Keep the local maxima of R above the threshold (non-maximum suppression).
+ * 7. Optionally keep only the strongest corners, spread over a grid.
+ *
+ * @param input      Input image (grayscale).
+ * @param k          Harris corner detector parameter (usually in the range of 0.04 to 0.06).
+ * @param sobelSize  Size of the Sobel kernel for derivative computation.
+ * @param threshTH   Threshold for corner detection, on R normalized to [0, 255] (default is 70).
+ * @param blurSize   Size of the Gaussian filter kernel for smoothing (default is 3).
+ * @param blurSigma  Standard deviation for Gaussian blur (default is 0.5).
+ * @param nmsRadius  Radius of the non-maximum suppression window (default is 1, i.e. 3x3).
+ * @param maxCorners Maximum number of corners to return (default is 0, no limit).
+ * @param gridCells  Grid cells per side used to spread the corners when maxCorners is set (default is 1).
+ *
+ * @return The detected corners, with R stored in KeyPoint::response.
+ */
+std::vector<cv::KeyPoint> harris_corners(cv::Mat & input, float k, int sobelSize, int threshTH = 70, int blurSize = 3, float blurSigma = 0.5,
+                                         int nmsRadius = 1, int maxCorners = 0, int gridCells = 1) {
+    // Steps 1-5: Compute the Harris response, fusing derivatives, products and smoothing row by row.
+    cv::Mat response;
+    harrisResponse(input, response, k, sobelSize, blurSize, blurSigma);
+
+    // Step 6: Keep the local maxima above the threshold, mapped from the normalized range to raw R.
+    double minResponse, maxResponse;
+    cv::minMaxLoc(response, &minResponse, &maxResponse);
+    float rawTH = harrisRawThreshold(threshTH, minResponse, maxResponse);
+    std::vector<cv::KeyPoint> corners = harrisNonMaxSuppression(response, rawTH, nmsRadius);
+
+    // Step 7: Keep the strongest corners, spread over the image.
+    harrisSelectCorners(corners, input.size(), maxCorners, gridCells);
+
+    return corners;
+}
+
+/**
+ * Applies the Harris Corner Detector algorithm to an input image and draws the detected corners.
+ * See harris_corners for the parameters.
+ *
+ * @return An image with detected corners marked by circles.
+ */
+cv::Mat harris(cv::Mat & input, float k, int sobelSize, int threshTH = 70, int blurSize = 3, float blurSigma = 0.5,
+               int nmsRadius = 1, int maxCorners = 0, int gridCells = 1) {
+    std::vector<cv::KeyPoint> corners = harris_corners(input, k, sobelSize, threshTH, blurSize, blurSigma, nmsRadius, maxCorners, gridCells);
+    return harrisDrawCorners(input, corners);
+}
+
+/**
+ * Detects corners at several scales with the Harris Corner Detector algorithm.
+ *
+ * The image is reduced into a pyramid of numOctaves levels (each half the size of the previous one) and
+ * corners are detected on every level with the same kernels, which covers twice the scale at each octave
+ * for about 1.33x the cost of a single scale. The pyramid, the responses and the row buffers live in the
+ * given HarrisPyramid and are reused across levels and across calls.
+ *
+ * @param input      Input image (grayscale).
+ * @param pyramid    Pyramid storage, reused across calls.
+ * @param numOctaves Number of pyramid levels.
+ * @param k          Harris corner detector parameter (usually in the range of 0.04 to 0.06).
+ * @param sobelSize  Size of the Sobel kernel for derivative computation.
+ * @param threshTH   Threshold for corner detection, on each level's R normalized to [0, 255] (default is 70).
+ * @param blurSize   Size of the Gaussian filter kernel for smoothing (default is 3).
+ * @param blurSigma  Standard deviation for Gaussian blur (default is 0.5).
+ * @param nmsRadius  Radius of the non-maximum suppression window on each level (default is 1).
+ * @param maxCorners Maximum number of corners to return over all levels (default is 0, no limit).
+ * @param gridCells  Grid cells per side used to spread the corners when maxCorners is set (default is 1).
+ *
+ * @return The corners in input image coordinates; KeyPoint::octave is the pyramid level they come from.
+ */
+std::vector<cv::KeyPoint> harris_multiscale(cv::Mat & input, HarrisPyramid & pyramid, int numOctaves, float k, int sobelSize, int threshTH = 70,
+                                            int blurSize = 3, float blurSigma = 0.5, int nmsRadius = 1, int maxCorners = 0, int gridCells = 1) {
+    // Step 1: Build the pyramid in the preallocated levels.
+    harrisBuildPyramid(input, pyramid, numOctaves);
+
+    std::vector<cv::KeyPoint> corners;
+    for (int level = 0; level < (int) pyramid.levels.size(); ++level) {
+        // Step 2: Harris response of the level, reusing the row buffers.
+        cv::Mat & response = pyramid.responses.at(level);
+        harrisResponse(pyramid.levels.at(level), response, k, sobelSize, blurSize, blurSigma, &pyramid.buffers);
+
+        // Step 3: Local maxima above the threshold, mapped back to input coordinates.
+        double minResponse, maxResponse;
+        cv::minMaxLoc(response, &minResponse, &maxResponse);
+        float rawTH = harrisRawThreshold(threshTH, minResponse, maxResponse);
+        float scale = (float) (1 << level);
+        for (cv::KeyPoint corner : harrisNonMaxSuppression(response, rawTH, nmsRadius)) {
+            corner.pt = cv::Point2f(corner.pt.x * scale, corner.pt.y * scale);
+            corner.size *= scale;
+            corner.octave = level;
+            corners.push_back(corner);
+        }
+    }
+
+    // Step 4: Keep the strongest corners, spread over the image.
+    harrisSelectCorners(corners, input.size(), maxCorners, gridCells);
+
+    return corners;
+}
+
+/**
+ * Detects corners with the Harris Corner Detector algorithm using an absolute threshold on R.
+ *
+ * Without the normalization to [0, 255] the response never has to exist as a whole: the image is processed
+ * in bands of bandRows rows (read with a halo of harrisHaloRows() rows, so the result matches the whole
+ * image) and each corner is emitted as soon as its suppression window is known. Memory is O(width) apart
+ * from the corners, so the input can be a memory-mapped image much larger than the RAM.
+ * Use harrisCalibrateThreshold to map a threshold on the normalized response to rawTH.
  *
  * @param input     Input image (grayscale).
  * @param k         Harris corner detector parameter (usually in the range of 0.04 to 0.06).
  * @param sobelSize Size of the Sobel kernel for derivative computation.
- * @param threshTH  Threshold for corner detection (default is 70).
+ * @param rawTH     Absolute threshold on R.
  * @param blurSize  Size of the Gaussian filter kernel for smoothing (default is 3).
  * @param blurSigma Standard deviation for Gaussian blur (default is 0.5).
+ * @param nmsRadius Radius of the non-maximum suppression window (default is 1, i.e. 3x3).
+ * @param bandRows  Number of rows per band (default is 256).
  *
- * @return An image with detected corners marked by circles.
+ * @return The detected corners in scan order, with R stored in KeyPoint::response.
  */
-cv::Mat harris(cv::Mat & input, float k, int sobelSize, int threshTH = 70, int blurSize = 3, float blurSigma = 0.5) {
-    cv::Mat img = input.clone();
-
-    // Step 1: Compute horizontal and vertical derivatives.
-    cv::Mat x_gradient, y_gradient;
-    cv::Sobel(img, x_gradient, CV_32F, 1, 0, sobelSize);
-    cv::Sobel(img, y_gradient, CV_32F, 0, 1, sobelSize);
-
-    // Step 2: Calculate products of derivatives and their squares.
-    cv::Mat gradientProduct;
-    cv::multiply(x_gradient, y_gradient, gradientProduct);
-
-    cv::pow(x_gradient, 2, x_gradient);
-    cv::pow(y_gradient, 2, y_gradient);
-
-    // Step 3: Apply Gaussian smoothing to derivative images.
-    cv::GaussianBlur(x_gradient, x_gradient, cv::Size(blurSize, blurSize), blurSigma, blurSigma);
-    cv::GaussianBlur(y_gradient, y_gradient, cv::Size(blurSize, blurSize), blurSigma, blurSigma);
-    cv::GaussianBlur(gradientProduct, gradientProduct, cv::Size(blurSize, blurSize), blurSigma, blurSigma);
-
-    // Step 4: Compute elements of the structure tensor.
-    cv::Mat mainDiagonalProduct;
-    cv::multiply(x_gradient, y_gradient, mainDiagonalProduct);
-    cv::Mat secDiagonalProduct;
-    cv::pow(gradientProduct, 2, secDiagonalProduct);
-
-    // Step 5: Compute the Harris response function harrisResponse.
-    cv::Mat determinant = mainDiagonalProduct - secDiagonalProduct;
-
-    cv::Mat trace;
-    cv::pow(x_gradient + y_gradient, 2, trace);
-
-    cv::Mat harrisResponse = determinant - k * trace;
-    cv::normalize(harrisResponse, harrisResponse, 0, 255, cv::NORM_MINMAX, CV_8U);
-
-    // Step 6: Apply a threshold to detect corners.
-    cv::threshold(harrisResponse, harrisResponse, threshTH, 255, cv::THRESH_BINARY);
-
-    // Step 7: Draw circles on the input image at detected corner locations.
-    cv::Mat out = input.clone();
-    for (int y = 0; y < harrisResponse.rows; ++y) {
-        for (int x = 0; x < harrisResponse.cols; ++x) {
-            if (harrisResponse.at<uchar>(cv::Point(x, y)) > 0) {
-                cv::circle(out, cv::Point(x, y), 3, cv::Scalar(255), 1, 8, 0);
-            }
-        }
+std::vector<cv::KeyPoint> harris_streaming(cv::Mat & input, float k, int sobelSize, float rawTH, int blurSize = 3, float blurSigma = 0.5,
+                                           int nmsRadius = 1, int bandRows = 256) {
+    std::vector<cv::KeyPoint> corners;
+    HarrisBuffers buffers;
+    int halo = harrisHaloRows(sobelSize, blurSize, nmsRadius);
+
+    for (int bandBegin = 0; bandBegin < input.rows; bandBegin += bandRows) {
+        int bandEnd = std::min(bandBegin + bandRows, input.rows);
+
+        // Step 1: View the band with its halo, no copy is made.
+        int haloBegin = std::max(bandBegin - halo, 0);
+        int haloEnd = std::min(bandEnd + halo, input.rows);
+        cv::Mat band = input.rowRange(haloBegin, haloEnd);
+
+        // Step 2: Stream the response of the band and emit its corners in image coordinates.
+        harrisStreamCorners(band, bandBegin - haloBegin, bandEnd - haloBegin, k, sobelSize, blurSize, blurSigma, rawTH, nmsRadius,
+                            [&](const cv::KeyPoint & corner) {
+            corners.push_back(corner);
+            corners.back().pt.y += (float) haloBegin;
+        }, &buffers);
     }
 
-    return out;
+    return corners;
 }
 
 int main(int argc, char ** argv) {
@@ -82,9 +164,23 @@ int main(int argc, char ** argv) {
     int blurSize = 3;
     float blurSigma = 2.0;
     int threshTH = 60;
+    int nmsRadius = 1;
+    int maxCorners = 500;
+    int gridCells = 8;
 
-    cv::Mat harrisImg = harris(inputImg, k, sobelSize, threshTH, blurSize, blurSigma);
+    cv::Mat harrisImg = harris(inputImg, k, sobelSize, threshTH, blurSize, blurSigma, nmsRadius, maxCorners, gridCells);
     imshowWrapper("Harris Img", harrisImg);
 
+    int numOctaves = 4;
+    HarrisPyramid pyramid;
+    std::vector<cv::KeyPoint> multiscaleCorners = harris_multiscale(inputImg, pyramid, numOctaves, k, sobelSize, threshTH, blurSize, blurSigma, nmsRadius, maxCorners, gridCells);
+    cv::Mat multiscaleImg = harrisDrawCorners(inputImg, multiscaleCorners);
+    imshowWrapper("Harris Multi-scale Img", multiscaleImg);
+
+    float rawTH = harrisCalibrateThreshold(inputImg, threshTH, k, sobelSize, blurSize, blurSigma);
+    std::vector<cv::KeyPoint> streamingCorners = harris_streaming(inputImg, k, sobelSize, rawTH, blurSize, blurSigma, nmsRadius);
+    cv::Mat streamingImg = harrisDrawCorners(inputImg, streamingCorners);
+    imshowWrapper("Harris Streaming Img", streamingImg);
+
     return 0;
 }
\ No newline at end of file
@@ -1,89 +1,235 @@
 #include <opencv2/opencv.hpp>
 #include "../reusables/utils.h"
+#include "../reusables/edges.h"
+#include "../reusables/hough.h"
 
 /**
- * Applies the Hough Circles Detection algorithm to an input image.
+ * Detects circles with the Hough Circles Detection algorithm.
  *
  * This function performs the following steps:
  * 1. Applies Gaussian blur to reduce noise for Canny edge detector.
- * 2. Performs Canny edge detection to highlight edges.
- * 3. Computes Hough Transform to detect circles.
- * 4. Draws detected circles on the input image.
+ * 2. Performs Canny edge detection, collecting the edge pixels in a list.
+ * 3. Computes Hough Transform to detect circles, voting only with the listed edge pixels and the cached
+ *    midpoint circle offsets of each radius. The radii are processed in bands of radiusBand radii, each in
+ *    a 2D accumulator per radius that is reused by the next band, so memory is O(W * H * radiusBand)
+ *    instead of O(W * H * R). The radii of a band are voted in parallel, one slice per thread.
+ * 4. Keeps the peaks of each band (in parallel per radius), then removes the duplicates found at adjacent radii.
  *
- * @param input     Input image (grayscale).
- * @param houghTH   Threshold for circle detection in the Hough space.
- * @param radiusMin    Minimum radius of circles to detect.
- * @param radiusMax    Maximum radius of circles to detect.
+ * @param input      Input image (grayscale or BGR).
+ * @param houghTH    Threshold for circle detection in the Hough space, as a fraction (0 .. 1] of the circle: a full
+ *                   circle of radius r gets at most houghCircleOffsets(r).size() votes (about 5.7 * r), and a
+ *                   center needs more than houghTH times that.
+ * @param radiusMin  Minimum radius of circles to detect.
+ * @param radiusMax  Maximum radius of circles to detect.
+ * @param cannyTHL   Lower threshold for Canny edge detection.
+ * @param cannyTHH   Upper threshold for Canny edge detection.
+ * @param blurSize   Size of the Gaussian filter kernel for smoothing (default is 3).
+ * @param blurSigma  Standard deviation for Gaussian blur (default is 0.5).
+ * @param radiusBand Number of radii voted at once, in parallel (default is 1).
+ *
+ * @return The detected circles, sorted by decreasing votes.
+ */
+std::vector<HoughCircle> hough_circles_detect(cv::Mat & input, double houghTH, int radiusMin, int radiusMax, int cannyTHL, int cannyTHH, int blurSize = 3,
+                                              float blurSigma = 0.5, int radiusBand = 1) {
+    cv::Mat img = input.clone();
+
+    // Step 1: Apply Gaussian blur to reduce noise.
+    cv::GaussianBlur(img, img, cv::Size(blurSize, blurSize), blurSigma);
+
+    // Step 2: Perform Canny edge detection, keeping only the list of edge pixels.
+    std::vector<EdgePoint> edgePoints;
+    cannyEdgePoints(img, cannyTHL, cannyTHH, edgePoints);
+
+    // Step 3: Compute Hough Transform to detect circles, one band of radii at a time.
+    std::vector<HoughCircle> circles;
+    cv::Mat votes;
+    for (int bandBegin = radiusMin; bandBegin <= radiusMax; bandBegin += radiusBand) {
+        int numRadii = std::min(radiusBand, radiusMax - bandBegin + 1);
+        houghVoteCircles(edgePoints, img.size(), bandBegin, numRadii, votes);
+
+        // Step 4: Keep only the peaks of the band.
+        houghCirclePeaksFraction(votes, img.size(), bandBegin, houghTH, circles);
+    }
+    houghSuppressCircles(circles, 1, 1);
+
+    return circles;
+}
+
+/**
+ * Applies the Hough Circles Detection algorithm to an input image and draws the detected circles.
+ * See hough_circles_detect for the parameters.
+ *
+ * @return An image with detected circles drawn on it.
+ */
+cv::Mat hough_circles(cv::Mat & input, double houghTH, int radiusMin, int radiusMax, int cannyTHL, int cannyTHH, int blurSize = 3, float blurSigma = 0.5,
+                      int radiusBand = 1) {
+    std::vector<HoughCircle> circles = hough_circles_detect(input, houghTH, radiusMin, radiusMax, cannyTHL, cannyTHH, blurSize, blurSigma, radiusBand);
+
+    cv::Mat out = input.clone();
+    houghDrawCircles(out, circles, cv::Scalar(0));
+    return out;
+}
+
+/**
+ * Detects circles with the gradient-directed (two-stage) Hough Circles Detection algorithm.
+ *
+ * This function performs the following steps:
+ * 1. Applies Gaussian blur to reduce noise for Canny edge detector.
+ * 2. Performs Canny edge detection, collecting the edge pixels in a list, and computes their Sobel gradient.
+ * 3. Votes the centers: each edge pixel votes only along its gradient direction, in both signs, for every
+ *    radius in [radiusMin, radiusMax], in a 2D accumulator.
+ * 4. Keeps the peaks of the centers accumulator above centerTH.
+ * 5. Estimates the radius of each center from the histogram of the distances of the edge pixels, keeping
+ *    the circles supported by more than radiusTH edge pixels and farther than minDist from a stronger one.
+ * The cost is O(edges * R) and the memory O(W * H), instead of O(edges * R * 360) and O(W * H * R).
+ *
+ * @param input     Input image (grayscale or BGR).
+ * @param centerTH  Threshold on the votes of a center.
+ * @param radiusTH  Threshold on the edge pixels supporting the radius of a center.
+ * @param radiusMin Minimum radius of circles to detect.
+ * @param radiusMax Maximum radius of circles to detect.
  * @param cannyTHL  Lower threshold for Canny edge detection.
  * @param cannyTHH  Upper threshold for Canny edge detection.
  * @param blurSize  Size of the Gaussian filter kernel for smoothing (default is 3).
  * @param blurSigma Standard deviation for Gaussian blur (default is 0.5).
+ * @param minDist   Minimum distance between the centers of two circles, on each axis (default is 1).
  *
- * @return An image with detected circles drawn on it.
+ * @return The detected circles, sorted by decreasing votes.
  */
-cv::Mat hough_circles(cv::Mat & input, int houghTH, int radiusMin, int radiusMax, int cannyTHL, int cannyTHH, int blurSize = 3, float blurSigma = 0.5) {
+std::vector<HoughCircle> hough_circles_gradient(cv::Mat & input, int centerTH, int radiusTH, int radiusMin, int radiusMax, int cannyTHL, int cannyTHH,
+                                                int blurSize = 3, float blurSigma = 0.5, int minDist = 1) {
     cv::Mat img = input.clone();
 
     // Step 1: Apply Gaussian blur to reduce noise.
     cv::GaussianBlur(img, img, cv::Size(blurSize, blurSize), blurSigma);
 
-    // Step 2: Perform Canny edge detection to highlight edges.
-    cv::Canny(img, img, cannyTHL, cannyTHH);
-
-    // Step 3: Compute Hough Transform to detect circles.
-    int radiusOffset = radiusMax - radiusMin + 1;
-    int sizes[] = {img.cols, img.rows, radiusOffset};
-    cv::Mat votes = cv::Mat(3, sizes, CV_8U, cv::Scalar(0));
-
-    for (int y = 0; y < img.rows; ++y) {
-        for (int x = 0; x < img.cols; ++x) {
-            if (img.at<uchar>(cv::Point(x, y)) == 255) {
-                for (int radius = radiusMin; radius < radiusMax; ++radius) {
-                    for (int thetaDegrees = 0; thetaDegrees < 360; ++thetaDegrees) {
-                        double thetaRadiants = thetaDegrees * CV_PI / 180;
-
-                        // Calculate the center coordinates (alpha, beta) of the potential circle.
-                        int alpha = cvRound(x - radius * std::cos(thetaRadiants));
-                        int beta = cvRound(y - radius * std::sin(thetaRadiants));
-
-                        // Ensure the center coordinates are within the image bounds.
-                        if (alpha >= 0 and alpha < img.cols and beta >= 0 and beta < img.rows)
-                            votes.at<uchar>(alpha, beta, radius - radiusMin)++;
-                    }
-                }
-            }
-        }
+    // Step 2: Perform Canny edge detection, keeping only the list of edge pixels, and their gradient.
+    std::vector<EdgePoint> edgePoints;
+    cannyEdgePoints(img, cannyTHL, cannyTHH, edgePoints);
+    // Same Sobel operator (and BGR channel) as Canny, so every edge pixel has a non-zero gradient.
+    std::vector<cv::Point> gradients;
+    houghEdgeGradients(img, edgePoints, gradients);
+
+    // Step 3: Vote the centers along the gradients.
+    cv::Mat votes;
+    houghVoteCircleCenters(edgePoints, gradients, img.size(), radiusMin, radiusMax, votes);
+
+    // Step 4: Keep the peaks of the centers accumulator.
+    std::vector<HoughCircle> centers;
+    houghCirclePeaks(votes, img.size(), 0, centerTH, centers);
+
+    // Step 5: Estimate the radius of each center.
+    std::vector<HoughCircle> circles;
+    std::vector<int> histogram;
+    for (const HoughCircle & center : centers) {
+        HoughCircle circle = houghEstimateRadius(edgePoints, center.center, radiusMin, radiusMax, histogram);
+        if (circle.votes > radiusTH)
+            circles.push_back(circle);
     }
+    houghSuppressCircles(circles, minDist, radiusMax);
 
-    // Step 4: Draw detected circles on the input image.
-    cv::Mat out = input.clone();
-    for (int radius = radiusMin; radius < radiusMax; ++radius) {
-        for (int alpha = 0; alpha < img.cols; ++alpha) {
-            for (int beta = 0; beta < img.rows; ++beta) {
-                if (votes.at<uchar>(alpha, beta, radius - radiusMin) > houghTH) {
-                    // Draw a circle with the detected radius and center.
-                    cv::circle(out, cv::Point(alpha, beta), radius, cv::Scalar(0), 2, 8);
-                }
-            }
-        }
+    return circles;
+}
+
+/**
+ * Detects circles with a coarse-to-fine search of the Hough Circles Detection algorithm.
+ *
+ * This function performs the following steps:
+ * 1. Applies Gaussian blur to reduce noise for Canny edge detector.
+ * 2. Performs Canny edge detection, collecting the edge pixels in a list.
+ * 3. Reduces the edge map by factor and detects candidate circles on it, with the radius range scaled by
+ *    1 / factor: the voting is about factor^3 times cheaper. The threshold is the same fraction of the
+ *    (smaller) coarse rings, since the votes of a circle grow linearly with its radius.
+ * 4. Refines each candidate at full resolution, only in a (center, radius) neighbourhood of +-factor pixels,
+ *    and keeps the circles with more than houghTH of their full resolution ring voting.
+ *
+ * @param input     Input image (grayscale or BGR).
+ * @param houghTH   Threshold for circle detection in the Hough space, as a fraction (0 .. 1] of the circle:
+ *                  a center of radius r needs more than houghTH * houghCircleOffsets(r).size() votes.
+ * @param radiusMin Minimum radius of circles to detect.
+ * @param radiusMax Maximum radius of circles to detect.
+ * @param cannyTHL  Lower threshold for Canny edge detection.
+ * @param cannyTHH  Upper threshold for Canny edge detection.
+ * @param blurSize  Size of the Gaussian filter kernel for smoothing (default is 3).
+ * @param blurSigma Standard deviation for Gaussian blur (default is 0.5).
+ * @param factor    Reduction factor of the coarse search, usually 2 or 4 (default is 2).
+ *
+ * @return The detected circles, sorted by decreasing votes.
+ */
+std::vector<HoughCircle> hough_circles_pyramid(cv::Mat & input, double houghTH, int radiusMin, int radiusMax, int cannyTHL, int cannyTHH,
+                                               int blurSize = 3, float blurSigma = 0.5, int factor = 2) {
+    cv::Mat img = input.clone();
+
+    // Step 1: Apply Gaussian blur to reduce noise.
+    cv::GaussianBlur(img, img, cv::Size(blurSize, blurSize), blurSigma);
+
+    // Step 2: Perform Canny edge detection, keeping only the list of edge pixels.
+    std::vector<EdgePoint> edgePoints;
+    cannyEdgePoints(img, cannyTHL, cannyTHH, edgePoints);
+
+    // Step 3: Detect candidate circles on the reduced edge map.
+    std::vector<EdgePoint> coarsePoints;
+    cv::Size coarseSize;
+    houghDownsampleEdges(edgePoints, img.size(), factor, coarsePoints, coarseSize);
+
+    int coarseRadiusMin = std::max(radiusMin / factor, 1);
+    int coarseRadiusMax = (radiusMax + factor - 1) / factor;
+    int coarseBand = cv::getNumThreads();
+    std::vector<HoughCircle> candidates;
+    cv::Mat votes;
+    for (int bandBegin = coarseRadiusMin; bandBegin <= coarseRadiusMax; bandBegin += coarseBand) {
+        int numRadii = std::min(coarseBand, coarseRadiusMax - bandBegin + 1);
+        houghVoteCircles(coarsePoints, coarseSize, bandBegin, numRadii, votes);
+        houghCirclePeaksFraction(votes, coarseSize, bandBegin, houghTH, candidates);
     }
-    return out;
+    houghSuppressCircles(candidates, 1, 1);
+
+    // Step 4: Refine the candidates at full resolution.
+    cv::Mat edgeMask = cv::Mat::zeros(img.size(), CV_8U);
+    for (const EdgePoint & edge : edgePoints)
+        edgeMask.at<uchar>(edge.y, edge.x) = 1;
+
+    std::vector<HoughCircle> circles;
+    for (const HoughCircle & candidate : candidates) {
+        cv::Point center(candidate.center.x * factor + factor / 2, candidate.center.y * factor + factor / 2);
+        HoughCircle scaled = {center, candidate.radius * factor, candidate.votes};
+        HoughCircle circle = houghRefineCircle(edgeMask, scaled, factor, radiusMin, radiusMax);
+        if (circle.votes > houghCircleVoteThreshold(circle.radius, houghTH))
+            circles.push_back(circle);
+    }
+    houghSuppressCircles(circles, 1, 1);
+
+    return circles;
 }
 
 int main(int argc, char ** argv) {
-    cv::Mat inputImg = imreadWrapper(argc, argv, cv::IMREAD_GRAYSCALE);
+    cv::Mat inputImg = imreadWrapper(argc, argv, cv::IMREAD_COLOR);
     imshowWrapper("Input Img", inputImg);
 
-    int houghTH = 190;
+    double houghTH = 0.5;
     int radMin = 20;
     int radMax = 70;
     int cannyTHL = 40;
     int cannyTHH = 80;
     int blurSize = 1;
     float blurSigma  = 0.0;
+    int radiusBand = cv::getNumThreads();
 
-    cv::Mat circlesImg = hough_circles(inputImg, houghTH, radMin, radMax, cannyTHL, cannyTHH, blurSize, blurSigma);
+    cv::Mat circlesImg = hough_circles(inputImg, houghTH, radMin, radMax, cannyTHL, cannyTHH, blurSize, blurSigma, radiusBand);
     imshowWrapper("Hough Circles", circlesImg);
 
+    int centerTH = 30;
+    int radiusTH = 60;
+    std::vector<HoughCircle> gradientCircles = hough_circles_gradient(inputImg, centerTH, radiusTH, radMin, radMax, cannyTHL, cannyTHH, blurSize, blurSigma, radMin);
+    cv::Mat gradientImg = inputImg.clone();
+    houghDrawCircles(gradientImg, gradientCircles, cv::Scalar(0));
+    imshowWrapper("Hough Circles (gradient)", gradientImg);
+
+    int factor = 2;
+    std::vector<HoughCircle> pyramidCircles = hough_circles_pyramid(inputImg, houghTH, radMin, radMax, cannyTHL, cannyTHH, blurSize, blurSigma, factor);
+    cv::Mat pyramidImg = inputImg.clone();
+    houghDrawCircles(pyramidImg, pyramidCircles, cv::Scalar(0));
+    imshowWrapper("Hough Circles (coarse-to-fine)", pyramidImg);
+
     return 0;
 }
\ No newline at end of file
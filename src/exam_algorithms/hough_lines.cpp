@@ -1,80 +1,119 @@
 #include <opencv2/opencv.hpp>
 #include "../reusables/utils.h"
+#include "../reusables/edges.h"
+#include "../reusables/hough.h"
 
 /**
- * Applies the Hough Lines Detection algorithm to an input image.
+ * Detects lines with the Hough Lines Detection algorithm.
  *
  * This function performs the following steps:
  * 1. Applies Gaussian blur to reduce noise for Canny edge detector.
- * 2. Performs Canny edge detection to highlight edges.
- * 3. Computes Hough Transform to detect lines.
- * 4. Draws detected lines on the input image.
+ * 2. Performs Canny edge detection, collecting the edge pixels in a list.
+ * 3. Computes Hough Transform to detect lines, voting only with the listed edge pixels. rho is computed
+ *    with fixed point sin/cos tables, in a theta-major accumulator with 16 or 32 bit counters. Slices of
+ *    theta are voted in parallel. With deltaTheta >= 0 each edge pixel votes only the thetas within
+ *    deltaTheta bins of its Sobel gradient direction, which cuts the votes and sharpens the peaks.
+ * 4. Extracts the peaks of the accumulator above the threshold (non-maximum suppression), optionally
+ *    keeping only the strongest ones.
  *
- * @param input     Input image (grayscale).
- * @param houghTH   Threshold for line detection in the Hough space.
- * @param cannyTHL  Lower threshold for Canny edge detection.
- * @param cannyTHH  Upper threshold for Canny edge detection.
- * @param blurSize  Size of the Gaussian filter kernel for smoothing.
- * @param blurSigma Standard deviation for Gaussian blur.
+ * @param input      Input image (grayscale or BGR).
+ * @param houghTH    Threshold for line detection in the Hough space.
+ * @param cannyTHL   Lower threshold for Canny edge detection.
+ * @param cannyTHH   Upper threshold for Canny edge detection.
+ * @param blurSize   Size of the Gaussian filter kernel for smoothing.
+ * @param blurSigma  Standard deviation for Gaussian blur.
+ * @param numTheta   Number of theta bins over [0, pi) (default is 180, i.e. 1 degree).
+ * @param numSlices  Number of theta slices voted in parallel (default is 1).
+ * @param deltaTheta Half-width in bins of the thetas voted around the gradient (default is -1, all thetas).
+ * @param nmsRadius  Radius in bins of the non-maximum suppression in the accumulator (default is 2).
+ * @param maxLines   Maximum number of lines to return, the ones with the most votes (default is 0, no limit).
  *
- * @return An image with detected lines drawn on it.
+ * @return The detected lines.
  */
-cv::Mat hough_lines(cv::Mat & input, int houghTH, int cannyTHL, int cannyTHH, int blurSize, float blurSigma) {
+std::vector<HoughLine> hough_lines_detect(cv::Mat & input, int houghTH, int cannyTHL, int cannyTHH, int blurSize, float blurSigma, int numTheta = 180,
+                                          int numSlices = 1, int deltaTheta = -1, int nmsRadius = 2, int maxLines = 0) {
     cv::Mat img = input.clone();
 
     // Step 1: Apply Gaussian blur to reduce noise.
     cv::GaussianBlur(img, img, cv::Size(blurSize, blurSize), blurSigma);
 
-    // Step 2: Perform Canny edge detection to highlight edges.
-    cv::Canny(img, img, cannyTHL, cannyTHH);
+    // Step 2: Perform Canny edge detection, keeping only the list of edge pixels.
+    std::vector<EdgePoint> edgePoints;
+    cannyEdgePoints(img, cannyTHL, cannyTHH, edgePoints);
 
     // Step 3: Compute Hough Transform to detect lines.
-    int diagonalLenght = cvRound(std::hypot(img.rows, img.cols));
-    int maxTheta = 180;
-    cv::Mat votes = cv::Mat::zeros(diagonalLenght * 2, maxTheta, CV_8U);
-
-    for (int y = 0; y < img.rows; ++y) {
-        for (int x = 0; x < img.cols; ++x) {
-            if (img.at<uchar>(cv::Point(x, y)) == 255) {
-                for (int theta = 0; theta < maxTheta; ++theta) {
-                    int rho = cvRound(x * std::cos(theta) + y * std::sin(theta));
-                    int rhoIndex = rho + diagonalLenght;
-                    votes.at<uchar>(rhoIndex, theta)++;
-                }
-            }
-        }
+    HoughTrigTable trigTable = houghTrigTable(numTheta);
+    cv::Mat votes;
+    if (deltaTheta >= 0) {
+        // Gradient direction of the edge pixels, from the same Sobel operator (and BGR channel) as Canny.
+        std::vector<int> edgeThetas;
+        houghEdgeThetas(img, edgePoints, numTheta, edgeThetas);
+        houghVoteLines(edgePoints, img.size(), trigTable, votes, numSlices, &edgeThetas, deltaTheta);
+    } else {
+        houghVoteLines(edgePoints, img.size(), trigTable, votes, numSlices);
     }
 
-    // Step 4: Draw detected lines on the input image.
-    int lineOffset = diagonalLenght * 2;
-    cv::Mat lineImg = input.clone();
-    for (int rhoIndex = 0; rhoIndex < votes.rows; ++rhoIndex) {
-        for (int theta = 0; theta < votes.cols; ++theta) {
-            if (votes.at<uchar>(rhoIndex, theta) > houghTH) {
-                int rho = rhoIndex - diagonalLenght;
-
-                // Finding two points to draw the line
-                int x0 = cvRound(rho * std::cos(theta));
-                int y0 = cvRound(rho * std::sin(theta));
-
-                cv::Point point1;
-                point1.x = cvRound(x0 + lineOffset * (-std::sin(theta)));
-                point1.y = cvRound(y0 + lineOffset * std::cos(theta));
-
-                cv::Point point2;
-                point2.x = cvRound(x0 - lineOffset * (-std::sin(theta)));
-                point2.y = cvRound(y0 - lineOffset * std::cos(theta));
-
-                cv::line(lineImg, point1, point2, cv::Scalar(0), 2, 0);
-            }
-        }
-    }
+    // Step 4: Keep the local maxima above the threshold.
+    return houghLinePeaks(votes, houghTH + 1, nmsRadius, maxLines);
+}
+
+/**
+ * Applies the Hough Lines Detection algorithm to an input image and draws the detected lines.
+ * See hough_lines_detect for the parameters.
+ *
+ * @return An image with detected lines drawn on it.
+ */
+cv::Mat hough_lines(cv::Mat & input, int houghTH, int cannyTHL, int cannyTHH, int blurSize, float blurSigma, int numTheta = 180, int numSlices = 1,
+                    int deltaTheta = -1, int nmsRadius = 2, int maxLines = 0) {
+    std::vector<HoughLine> lines = hough_lines_detect(input, houghTH, cannyTHL, cannyTHH, blurSize, blurSigma, numTheta, numSlices, deltaTheta,
+                                                      nmsRadius, maxLines);
 
+    cv::Mat lineImg = input.clone();
+    houghDrawLines(lineImg, lines, cv::Scalar(0), 2, 0);
     return lineImg;
 }
 
+/**
+ * Detects line segments with the progressive probabilistic Hough transform.
+ *
+ * This function performs the following steps:
+ * 1. Applies Gaussian blur to reduce noise for Canny edge detector.
+ * 2. Performs Canny edge detection, collecting the edge pixels in a list.
+ * 3. Votes with the edge pixels in random order; whenever a bin reaches houghTH, walks the edge map along
+ *    its line to extract a segment and removes the pixels of the segment from further voting.
+ *
+ * @param input         Input image (grayscale or BGR).
+ * @param houghTH       Votes needed to extract a segment.
+ * @param minLineLength Minimum length of a segment, in pixels.
+ * @param maxLineGap    Maximum gap between two edge pixels of the same segment, in pixels.
+ * @param cannyTHL      Lower threshold for Canny edge detection.
+ * @param cannyTHH      Upper threshold for Canny edge detection.
+ * @param blurSize      Size of the Gaussian filter kernel for smoothing.
+ * @param blurSigma     Standard deviation for Gaussian blur.
+ * @param numTheta      Number of theta bins over [0, pi) (default is 180, i.e. 1 degree).
+ *
+ * @return The segments as (x1, y1, x2, y2).
+ */
+std::vector<cv::Vec4i> hough_lines_segments(cv::Mat & input, int houghTH, int minLineLength, int maxLineGap, int cannyTHL, int cannyTHH,
+                                            int blurSize, float blurSigma, int numTheta = 180) {
+    cv::Mat img = input.clone();
+
+    // Step 1: Apply Gaussian blur to reduce noise.
+    cv::GaussianBlur(img, img, cv::Size(blurSize, blurSize), blurSigma);
+
+    // Step 2: Perform Canny edge detection, keeping only the list of edge pixels.
+    std::vector<EdgePoint> edgePoints;
+    cannyEdgePoints(img, cannyTHL, cannyTHH, edgePoints);
+
+    // Step 3: Progressive probabilistic Hough transform.
+    std::vector<cv::Vec4i> segments;
+    houghLineSegments(edgePoints, img.size(), houghTrigTable(numTheta), houghTH, minLineLength, maxLineGap, segments);
+
+    return segments;
+}
+
 int main(int argc, char ** argv) {
-    cv::Mat inputImg = imreadWrapper(argc, argv, cv::IMREAD_GRAYSCALE);
+    cv::Mat inputImg = imreadWrapper(argc, argv, cv::IMREAD_COLOR);
     imshowWrapper("inputImg" ,inputImg);
 
     int houghTH = 150;
@@ -82,10 +121,24 @@ int main(int argc, char ** argv) {
     int cannyTHH  = 80;
     int blurSize  = 1;
     float blurSigma  = 0.0;
+    int numTheta = 180;
+    int numSlices = cv::getNumThreads();
+    int deltaTheta = 10;
+    int nmsRadius = 2;
+    int maxLines = 50;
 
-    cv::Mat linesImg = hough_lines(inputImg, houghTH, cannyTHL, cannyTHH, blurSize, blurSigma);
+    cv::Mat linesImg = hough_lines(inputImg, houghTH, cannyTHL, cannyTHH, blurSize, blurSigma, numTheta, numSlices, deltaTheta, nmsRadius, maxLines);
     imshowWrapper("Hough Lines", linesImg);
 
+    int segmentsTH = 50;
+    int minLineLength = 30;
+    int maxLineGap = 5;
+    std::vector<cv::Vec4i> segments = hough_lines_segments(inputImg, segmentsTH, minLineLength, maxLineGap, cannyTHL, cannyTHH, blurSize, blurSigma, numTheta);
+    cv::Mat segmentsImg = inputImg.clone();
+    for (const cv::Vec4i & segment : segments)
+        cv::line(segmentsImg, cv::Point(segment[0], segment[1]), cv::Point(segment[2], segment[3]), cv::Scalar(0, 0, 255), 2, cv::LINE_AA);
+    imshowWrapper("Hough Segments", segmentsImg);
+
     return 0;
 }
 
@@ -1,6 +1,8 @@
 #include <opencv2/opencv.hpp>
+#include <climits>
 #include <cstdlib>
 #include "../reusables/utils.h"
+#include "../reusables/histogram.h"
 
 /**
  * Applies the numberOfClusters-means clustering algorithm to a grayscale image.
@@ -31,7 +33,7 @@ cv::Mat kmeans_gray(cv::Mat &input, int numberOfClusters, int maxIterations, dou
     std::vector<std::vector<cv::Point>> clusters(numberOfClusters);
     cv::Mat clusteredImg = img.clone();
 
-    while (isCentreUpdated or iterations < maxIterations) {
+    while (isCentreUpdated and iterations < maxIterations) {
         // Resetting centre update flag and cluster containers
         isCentreUpdated = false;
 
@@ -42,7 +44,7 @@ cv::Mat kmeans_gray(cv::Mat &input, int numberOfClusters, int maxIterations, dou
         for (int y = 0; y < img.rows; ++y) {
             for (int x = 0; x < img.cols; ++x) {
                 int currentDistance;
-                int minDistance = INFINITY;
+                int minDistance = INT_MAX;
                 for (int i = 0; i < numberOfClusters; ++i) {
                     currentDistance = std::abs(centres.at(i) - img.at<uchar>(cv::Point(x, y)));
                     if (currentDistance < minDistance) {
@@ -78,6 +80,90 @@ cv::Mat kmeans_gray(cv::Mat &input, int numberOfClusters, int maxIterations, dou
     return clusteredImg;
 }
 
+/**
+ * Applies the numberOfClusters-means clustering algorithm to a grayscale image, working on its histogram.
+ *
+ * Pixels with the same intensity always fall in the same cluster, so the Lloyd iterations can run on the
+ * 256 gray levels weighted by their counts instead of on the pixels: every iteration costs O(L * k) and
+ * no per-pixel point lists are kept. The image is read once for the histogram and once for the final
+ * assignment, done with a lookup table from gray level to cluster centre.
+ *
+ * @param input             The input grayscale image to be clustered.
+ * @param numberOfClusters  The number of clusters to create.
+ * @param maxIterations     The maximum number of iterations for the algorithm.
+ * @param deltaTH           The threshold for center updates to stop iterations.
+ * @return                  The clustered grayscale image.
+ */
+cv::Mat kmeans_gray_histogram(cv::Mat &input, int numberOfClusters, int maxIterations, double deltaTH = 1.0) {
+    // Step 1: Compute the image histogram (stripes histogrammed in parallel).
+    std::vector<int> histogram;
+    computeHistogram(input, histogram, cv::Mat(), cv::getNumThreads());
+
+    // Step 2: Initialize cluster centres randomly.
+    srand(time(nullptr) + 1);
+    std::vector<uchar> centres(numberOfClusters);
+    for (int i = 0; i < numberOfClusters; ++i) {
+        int x = rand() % input.cols;
+        int y = rand() % input.rows;
+        centres.at(i) = input.at<uchar>(cv::Point(x, y));
+    }
+
+    // Closest cluster of every gray level.
+    std::vector<int> closestCluster(HISTOGRAM_BINS, 0);
+    auto assignLevels = [&]() {
+        for (int level = 0; level < HISTOGRAM_BINS; ++level) {
+            int minDistance = INT_MAX;
+            for (int i = 0; i < numberOfClusters; ++i) {
+                int currentDistance = std::abs(centres.at(i) - level);
+                if (currentDistance < minDistance) {
+                    minDistance = currentDistance;
+                    closestCluster.at(level) = i;
+                }
+            }
+        }
+    };
+
+    // Iterate until cluster centres stabilize or until maxIterations is reached
+    int iterations = 0;
+    bool isCentreUpdated = true;
+    while (isCentreUpdated and iterations < maxIterations) {
+        isCentreUpdated = false;
+
+        // Step 3: Assign each gray level to the closest cluster centre, weighted by its count.
+        assignLevels();
+        std::vector<long long> intensitySums(numberOfClusters, 0);
+        std::vector<long long> clusterSizes(numberOfClusters, 0);
+        for (int level = 0; level < HISTOGRAM_BINS; ++level) {
+            intensitySums.at(closestCluster.at(level)) += (long long) level * histogram.at(level);
+            clusterSizes.at(closestCluster.at(level)) += histogram.at(level);
+        }
+
+        // Step 4: Check if centres must be updated. Calculate the new mean of each cluster.
+        for (int i = 0; i < numberOfClusters; ++i) {
+            if (clusterSizes.at(i) > 0) {
+                double currentMean = (double) intensitySums.at(i) / clusterSizes.at(i);
+                int delta = cvRound(std::abs(currentMean - centres.at(i)));
+
+                if (delta > deltaTH) {
+                    centres.at(i) = cvRound(currentMean);
+                    isCentreUpdated = true;
+                }
+            }
+        }
+        iterations++;
+    }
+
+    // Step 5: Map every pixel to the centre of its cluster with a single lookup table pass.
+    assignLevels();
+    cv::Mat lut(1, HISTOGRAM_BINS, CV_8U);
+    for (int level = 0; level < HISTOGRAM_BINS; ++level)
+        lut.at<uchar>(0, level) = centres.at(closestCluster.at(level));
+
+    cv::Mat clusteredImg;
+    cv::LUT(input, lut, clusteredImg);
+    return clusteredImg;
+}
+
 int main(int argc, char **argv) {
     cv::Mat inputImg = imreadWrapper(argc, argv, cv::IMREAD_GRAYSCALE);
     imshowWrapper("Input Img", inputImg);
@@ -88,4 +174,7 @@ int main(int argc, char **argv) {
 
     cv::Mat kmeansImg = kmeans_gray(inputImg, k, maxIterations, deltaTH);
     imshowWrapper("K-Means (grayscale) Img", kmeansImg);
+
+    cv::Mat kmeansHistogramImg = kmeans_gray_histogram(inputImg, k, maxIterations, deltaTH);
+    imshowWrapper("K-Means (histogram) Img", kmeansHistogramImg);
 }
\ No newline at end of file
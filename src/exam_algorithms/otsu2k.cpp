@@ -1,6 +1,8 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 #include "../reusables/utils.h"
+#include "../reusables/histogram.h"
+#include "../reusables/otsu.h"
 
 /**
  * Applies Otsu's Two-Threshold Thresholding algorithm (Otsu2k) to an input image.
@@ -10,12 +12,11 @@
  * It finds two threshold values to separate these regions optimally.
  *
  * This function performs the following steps:
- * 1. Computes the normalized image histogram.
- * 2. Calculates the global cumulative mean.
- * 3. Iteratively computes three probabilities and cumulative means for different
- *    threshold combinations, seeking to maximize between-class variance.
- * 4. Applies Gaussian blur to the input image to reduce noise.
- * 5. Thresholds the blurred image using the two optimal threshold values.
+ * 1. Computes the normalized image histogram (integer counts, stripes histogrammed in parallel).
+ * 2. Finds the two thresholds maximizing the between-class variance with the multi-level
+ *    dynamic programming search (prefix sums of probabilities and cumulative means).
+ * 3. Applies Gaussian blur to the input image to reduce noise.
+ * 4. Thresholds the blurred image using the two optimal threshold values (lookup table).
  *
  * @param input     Input image (grayscale).
  * @param blurSize  Size of the Gaussian filter kernel for smoothing (default is 3).
@@ -27,79 +28,62 @@ cv::Mat otsu2k(cv::Mat& input, int blurSize = 3, float blurSigma = 0.5) {
     cv::Mat img = input.clone(); // Clone the input image to prevent modification.
 
     // Step 1: Compute the normalized image histogram.
-    std::vector<double> histogram(256, 0.0);
-    for (int y = 0; y < img.rows; ++y)
-        for (int x = 0; x < img.cols; ++x)
-            histogram.at(img.at<uchar>(cv::Point(x, y)))++; // Increment the histogram bin for each pixel value.
+    std::vector<int> counts;
+    int numberOfPixels = computeHistogram(img, counts, cv::Mat(), cv::getNumThreads());
+    std::vector<double> histogram(counts.begin(), counts.end());
 
     // Histogram Normalization
-    int numberOfPixels = img.rows * img.cols;
     for (double & bin : histogram)
         bin /= numberOfPixels;
 
-    // Step 2: Calculate the global cumulative mean.
-    double globalCumulativeMean = 0.0;
-    for (int i = 0; i < histogram.size(); ++i)
-        globalCumulativeMean += i * histogram.at(i);
+    // Step 2: Compute the optimal threshold values (first level of the middleground and of the foreground).
+    std::vector<int> optimalTH = otsuMultilevelThresholds(histogram, 3);
 
-    // Initialize variables for probabilities, cumulative means, and maximum between-class variance.
-    std::vector<double> probabilities(3, 0.0);
-    std::vector<double> cumulativeMeans(3, 0.0);
-    double betweenClassesVariance;
-    double maxVariance = 0.0;
-    std::vector<int> optimalTH(2, 0);
-
-    // Step 3: Iteratively compute optimal threshold values to maximize between-class variance.
-    for (int k1 = 0; k1 < histogram.size() - 2; ++k1) {
-        probabilities.at(0) += histogram.at(k1);
-        cumulativeMeans.at(0) += k1 * histogram.at(k1);
-
-        for (int k2 = k1 + 1; k2 < histogram.size() - 1; ++k2) {
-            probabilities.at(1) += histogram.at(k2);
-            cumulativeMeans.at(1) += k2 * histogram.at(k2);
-
-            for (int k = k2 + 1; k < histogram.size(); ++k) {
-                probabilities.at(2) += histogram.at(k);
-                cumulativeMeans.at(2) += k * histogram.at(k);
+    // Step 3: Apply Gaussian blur to reduce noise.
+    cv::GaussianBlur(img, img, cv::Size(blurSize, blurSize), blurSigma, blurSigma);
 
-                // Calculate between-class variance using Otsu's method.
-                betweenClassesVariance = 0.0;
-                for (int i = 0; i < 3; ++i) {
-                    // Pi * (mi - mg)^2
-                    double currentCumulativeMean = cumulativeMeans.at(i) / probabilities.at(i); // mi = 1/P1 * m
-                    betweenClassesVariance += probabilities.at(i) * std::pow(currentCumulativeMean - globalCumulativeMean, 2);
-                }
+    // Step 4: Threshold the blurred image using the two optimal threshold values.
+    // Background pixels are black (0), middleground pixels gray (128), foreground pixels white (255).
+    return otsuApplyLevels(img, optimalTH);
+}
 
-                // Update the optimal threshold values if higher variance is found.
-                if (betweenClassesVariance > maxVariance) {
-                    maxVariance = betweenClassesVariance;
-                    optimalTH.at(0) = k1;
-                    optimalTH.at(1) = k2;
-                }
-            }
-            probabilities.at(2) = 0.0;
-            cumulativeMeans.at(2) = 0.0;
-        }
-        probabilities.at(1) = 0.0;
-        cumulativeMeans.at(1) = 0.0;
-    }
+/**
+ * Applies multi-level Otsu thresholding to an input image.
+ *
+ * Generalizes Otsu2k to any number of classes: the numClasses - 1 thresholds maximizing the
+ * between-class variance are found with dynamic programming over the histogram prefix sums, in
+ * O(k * L log L) for L gray levels instead of the O(L^(k-1)) exhaustive search. 16 bit images are
+ * supported: the histogram is trimmed to the highest used value and reduced to at most maxLevels levels.
+ *
+ * This function performs the following steps:
+ * 1. Computes the image histogram (integer counts, stripes histogrammed in parallel).
+ * 2. Reduces it to the normalized histogram of the search levels.
+ * 3. Finds the optimal thresholds.
+ * 4. Maps every pixel to the gray level of its class with a lookup table.
+ *
+ * @param input      Input image (grayscale, 8 or 16 bit).
+ * @param numClasses Number of classes (e.g. 3 to 5).
+ * @param maxLevels  Maximum number of gray levels of the search (default is OTSU_MAX_LEVELS).
+ *
+ * @return 8 bit image with the classes mapped to evenly spaced gray levels (0 to 255).
+ */
+cv::Mat otsu_multilevel(cv::Mat& input, int numClasses, int maxLevels = OTSU_MAX_LEVELS) {
+    // Step 1: Compute the image histogram.
+    std::vector<int> counts;
+    computeHistogram(input, counts, cv::Mat(), cv::getNumThreads());
 
-    // Step 4: Apply Gaussian blur to reduce noise.
-    cv::GaussianBlur(img, img, cv::Size(blurSize, blurSize), blurSigma, blurSigma);
+    // Step 2: Reduce it to the normalized histogram of the search levels.
+    std::vector<double> histogram;
+    int shift = otsuReduceHistogram(counts, maxLevels, histogram);
 
-    // Step 5: Threshold the blurred image using the two optimal threshold values.
-    cv::Mat thresholdedImg = cv::Mat::zeros(img.rows, img.cols, CV_8U);
-    for (int x = 0; x < img.rows; ++x) {
-        for (int y = 0; y < img.cols; ++y) {
-            if (img.at<uchar>(x, y) >= optimalTH.at(1))
-                thresholdedImg.at<uchar>(x, y) = 255; // Foreground pixel.
-            else if (img.at<uchar>(x, y) >= optimalTH.at(0))
-                thresholdedImg.at<uchar>(x, y) = (255 + 1) / 2; // Middleground pixel.
-            // Background pixels remain black (0).
-        }
-    }
+    // Step 3: Find the optimal thresholds (at least one level per class).
+    numClasses = std::min(numClasses, (int) histogram.size());
+    if (numClasses < 2)
+        return cv::Mat::zeros(input.size(), CV_8U);
+    std::vector<int> optimalTH = otsuMultilevelThresholds(histogram, numClasses);
 
-    return thresholdedImg;
+    // Step 4: Map every pixel to the gray level of its class.
+    return otsuApplyLevels(input, optimalTH, shift);
 }
 
 int main(int argc, char ** argv) {
@@ -108,5 +92,8 @@ int main(int argc, char ** argv) {
 
     cv::Mat otsu2kImg = otsu2k(inputImg);
     imshowWrapper("Otsu2K Img", otsu2kImg);
+
+    cv::Mat otsuMultilevelImg = otsu_multilevel(inputImg, 4);
+    imshowWrapper("Otsu Multilevel Img", otsuMultilevelImg);
     return 0;
 }
\ No newline at end of file
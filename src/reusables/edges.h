@@ -0,0 +1,423 @@
+#ifndef OPENCVELIM_EDGES_H
+#define OPENCVELIM_EDGES_H
+
+#include <algorithm>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Gradient directions quantized to 2 bits, as used by the non-maximum suppression.
+#define EDGE_DIR_0 0      // Horizontal gradient: compare with the left/right neighbours.
+#define EDGE_DIR_45 1     // Gx and Gy with the same sign: compare with the up-left/down-right neighbours.
+#define EDGE_DIR_90 2     // Vertical gradient: compare with the up/down neighbours.
+#define EDGE_DIR_135 3    // Gx and Gy with opposite signs: compare with the up-right/down-left neighbours.
+
+// tan(22.5°) in Q15 fixed point. tan(67.5°) = tan(22.5°) + 2.
+#define EDGE_TG22_Q15 13573
+
+/**
+ * @struct EdgePoint
+ * @brief An edge pixel found by the Canny hysteresis, as consumed by the Hough transforms.
+ */
+struct EdgePoint {
+    int x;
+    int y;
+    uchar direction;    // EDGE_DIR_* code of the gradient.
+    ushort magnitude;   // L1 gradient magnitude.
+};
+
+/**
+ * Computes the 3x3 Sobel gradient (Gx, Gy) of a single pixel from three image rows. On multi-channel
+ * images the gradient of each channel is computed on the interleaved data and the channel with the
+ * largest L1 magnitude is kept.
+ *
+ * @tparam cn   Number of interleaved channels.
+ * @param up    Row above the pixel.
+ * @param cur   Row of the pixel.
+ * @param down  Row below the pixel.
+ * @param xl    Column of the left neighbour (already reflected at the image border).
+ * @param x     Column of the pixel.
+ * @param xr    Column of the right neighbour (already reflected at the image border).
+ * @param gx    Output horizontal derivative of the strongest channel.
+ * @param gy    Output vertical derivative of the strongest channel.
+ */
+template <int cn>
+inline void cannyGradientVector(const uchar * up, const uchar * cur, const uchar * down, int xl, int x, int xr, int & gx, int & gy) {
+    int strongest = 0;
+    for (int c = 0; c < cn; ++c) {
+        int l = xl * cn + c, m = x * cn + c, r = xr * cn + c;
+        int channelGx = (up[r] + 2 * cur[r] + down[r]) - (up[l] + 2 * cur[l] + down[l]);
+        int channelGy = (down[l] + 2 * down[m] + down[r]) - (up[l] + 2 * up[m] + up[r]);
+        int channelMag = std::abs(channelGx) + std::abs(channelGy);
+        if (c == 0 or channelMag > strongest) {
+            gx = channelGx;
+            gy = channelGy;
+            strongest = channelMag;
+        }
+    }
+}
+
+/**
+ * Computes the Sobel gradient of a single pixel from three image rows and quantizes its direction.
+ * On multi-channel images the channel with the largest magnitude gives both the magnitude and the
+ * direction of the pixel (see cannyGradientVector).
+ *
+ * @tparam cn   Number of interleaved channels.
+ * @param up    Row above the pixel.
+ * @param cur   Row of the pixel.
+ * @param down  Row below the pixel.
+ * @param xl    Column of the left neighbour (already reflected at the image border).
+ * @param x     Column of the pixel.
+ * @param xr    Column of the right neighbour (already reflected at the image border).
+ * @param mag   Output L1 magnitude |Gx| + |Gy|.
+ * @param dir   Output EDGE_DIR_* code.
+ */
+template <int cn>
+void cannyGradientPixel(const uchar * up, const uchar * cur, const uchar * down, int xl, int x, int xr, ushort & mag, uchar & dir) {
+    int gx, gy;
+    cannyGradientVector<cn>(up, cur, down, xl, x, xr, gx, gy);
+    int ax = std::abs(gx), ay = std::abs(gy);
+    mag = (ushort) (ax + ay);
+
+    // Compare |Gy| / |Gx| with tan(22.5°) and tan(67.5°) without dividing or calling atan.
+    int tg22x = ax * EDGE_TG22_Q15;
+    int ay15 = ay << 15;
+    if (ay15 < tg22x)
+        dir = EDGE_DIR_0;
+    else if (ay15 > tg22x + (ax << 16))
+        dir = EDGE_DIR_90;
+    else
+        dir = (gx ^ gy) < 0 ? EDGE_DIR_135 : EDGE_DIR_45;
+}
+
+/**
+ * Row loop of cannyGradient for an image with cn interleaved channels.
+ */
+template <int cn>
+void cannyGradientRows(const cv::Mat & src, int rowBegin, int rowEnd, cv::Mat & mag, cv::Mat & dir, int & minMag, int & maxMag) {
+    int rows = src.rows, cols = src.cols;
+    int lastX = cols - 1;
+    minMag = INT_MAX;
+    maxMag = 0;
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        const uchar * up = src.ptr<uchar>(y > 0 ? y - 1 : std::min(1, rows - 1));
+        const uchar * cur = src.ptr<uchar>(y);
+        const uchar * down = src.ptr<uchar>(y < rows - 1 ? y + 1 : std::max(rows - 2, 0));
+        ushort * magRow = mag.ptr<ushort>(y - rowBegin);
+        uchar * dirRow = dir.ptr<uchar>(y - rowBegin);
+
+        // The first and last columns reflect their missing neighbour, the rest is a straight loop.
+        cannyGradientPixel<cn>(up, cur, down, std::min(1, lastX), 0, std::min(1, lastX), magRow[0], dirRow[0]);
+        for (int x = 1; x < lastX; ++x)
+            cannyGradientPixel<cn>(up, cur, down, x - 1, x, x + 1, magRow[x], dirRow[x]);
+        if (lastX > 0)
+            cannyGradientPixel<cn>(up, cur, down, lastX - 1, lastX, lastX - 1, magRow[lastX], dirRow[lastX]);
+
+        for (int x = 0; x < cols; ++x) {
+            minMag = std::min(minMag, (int) magRow[x]);
+            maxMag = std::max(maxMag, (int) magRow[x]);
+        }
+    }
+}
+
+/**
+ * Computes the 3x3 Sobel gradient of rows [rowBegin, rowEnd) of an image in a single row-pointer pass,
+ * producing the L1 magnitude and the quantized gradient direction at once. Borders are reflected as
+ * cv::Sobel does (BORDER_REFLECT_101), so the rows above and below the range are read when they exist.
+ * Color images are handled directly on the interleaved BGR data, keeping the strongest channel per pixel.
+ *
+ * @param src      Input image (CV_8UC1 or CV_8UC3).
+ * @param rowBegin First row to compute.
+ * @param rowEnd   One past the last row to compute.
+ * @param mag      Output L1 magnitude (CV_16U), row i holds image row rowBegin + i.
+ * @param dir      Output direction codes (CV_8U, one of EDGE_DIR_*), same layout as mag.
+ * @param minMag   Smallest magnitude in the computed rows.
+ * @param maxMag   Largest magnitude in the computed rows.
+ */
+void cannyGradient(const cv::Mat & src, int rowBegin, int rowEnd, cv::Mat & mag, cv::Mat & dir, int & minMag, int & maxMag) {
+    CV_Assert(src.type() == CV_8UC1 or src.type() == CV_8UC3);
+    mag.create(rowEnd - rowBegin, src.cols, CV_16U);
+    dir.create(rowEnd - rowBegin, src.cols, CV_8U);
+
+    if (src.channels() == 3)
+        cannyGradientRows<3>(src, rowBegin, rowEnd, mag, dir, minMag, maxMag);
+    else
+        cannyGradientRows<1>(src, rowBegin, rowEnd, mag, dir, minMag, maxMag);
+}
+
+/**
+ * Computes the gradient of the whole image, see the row range version above.
+ */
+void cannyGradient(const cv::Mat & src, cv::Mat & mag, cv::Mat & dir, int & minMag, int & maxMag) {
+    cannyGradient(src, 0, src.rows, mag, dir, minMag, maxMag);
+}
+
+/**
+ * Non-maximum suppression of rows [rowBegin, rowEnd) on the output of cannyGradient: a pixel keeps its
+ * magnitude only if it is not smaller than both of its neighbours along the quantized gradient direction.
+ * Image border pixels are set to 0.
+ *
+ * @param mag         Gradient magnitude (CV_16U), row i holds image row magRowBegin + i. It must also
+ *                    contain the rows right above and below the range, where they exist.
+ * @param dir         Direction codes (CV_8U), same layout as mag.
+ * @param magRowBegin Image row of the first row of mag and dir.
+ * @param nms         Output thinned magnitude (CV_16U, already allocated with the full image size).
+ * @param rowBegin    First image row to compute.
+ * @param rowEnd      One past the last image row to compute.
+ */
+void cannyNonMaxSuppression(const cv::Mat & mag, const cv::Mat & dir, int magRowBegin, cv::Mat & nms, int rowBegin, int rowEnd) {
+    // Element offset of the "forward" neighbour for each direction code; the other one is at -offset.
+    int stride = (int) (mag.step / sizeof(ushort));
+    const int offsets[4] = {1, stride + 1, stride, stride - 1};
+
+    int lastX = nms.cols - 1;
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        ushort * nmsRow = nms.ptr<ushort>(y);
+        if (y == 0 or y == nms.rows - 1) {
+            std::fill(nmsRow, nmsRow + nms.cols, 0);
+            continue;
+        }
+
+        const ushort * magRow = mag.ptr<ushort>(y - magRowBegin);
+        const uchar * dirRow = dir.ptr<uchar>(y - magRowBegin);
+        nmsRow[0] = 0;
+        for (int x = 1; x < lastX; ++x) {
+            int offset = offsets[dirRow[x]];
+            ushort currentMagnitude = magRow[x];
+            bool isMaximum = currentMagnitude >= magRow[x + offset] and currentMagnitude >= magRow[x - offset];
+            nmsRow[x] = isMaximum ? currentMagnitude : 0;
+        }
+        nmsRow[lastX] = 0;
+    }
+}
+
+/**
+ * Non-maximum suppression of the whole image, see the row range version above.
+ */
+void cannyNonMaxSuppression(const cv::Mat & mag, const cv::Mat & dir, cv::Mat & nms) {
+    nms.create(mag.rows, mag.cols, CV_16U);
+    cannyNonMaxSuppression(mag, dir, 0, nms, 0, mag.rows);
+}
+
+/**
+ * Maps a threshold given on the magnitude normalized to [0, 255] (cv::NORM_MINMAX) back to raw
+ * magnitude units, so that the magnitude image never has to be normalized.
+ *
+ * @param th     Threshold in the normalized range.
+ * @param minMag Smallest raw magnitude.
+ * @param maxMag Largest raw magnitude.
+ *
+ * @return The largest raw magnitude whose normalized value is not above th: raw > result iff normalized > th.
+ */
+int cannyRawThreshold(int th, int minMag, int maxMag) {
+    if (maxMag <= minMag)
+        return maxMag;
+
+    double scale = 255.0 / (maxMag - minMag);
+    int raw = minMag - 1;
+    while (raw < maxMag and cvRound((raw + 1 - minMag) * scale) <= th)
+        raw++;
+    return raw;
+}
+
+/**
+ * Hysteresis thresholding on the output of cannyNonMaxSuppression: pixels above highTH are edges, and so are
+ * the pixels above lowTH that are 8-connected to an edge through other pixels above lowTH.
+ * Every pixel enters the worklist at most once, so the whole stage is O(N).
+ *
+ * When edgeList is given, the edges are also appended to it in scan order. The list is built from the
+ * weak pixels met during the seed scan, so producing it does not need another pass over the image.
+ *
+ * @param nms      Thinned magnitude (CV_16U) with zero borders.
+ * @param lowTH    Weak threshold (non-negative, so border pixels are never candidates).
+ * @param highTH   Strong threshold.
+ * @param edges    Output edge map (CV_8U, edges set to 255).
+ * @param edgeList Optional output list of edge pixels.
+ * @param dir      Direction codes (CV_8U, full image size), required when edgeList is given.
+ */
+void cannyHysteresis(const cv::Mat & nms, int lowTH, int highTH, cv::Mat & edges, std::vector<EdgePoint> * edgeList = nullptr, const cv::Mat & dir = cv::Mat()) {
+    CV_Assert(lowTH >= 0);
+    CV_Assert(edgeList == nullptr or dir.size() == nms.size());
+    edges = cv::Mat::zeros(nms.rows, nms.cols, CV_8U);
+
+    std::vector<cv::Point> worklist;
+    std::vector<EdgePoint> candidates;
+    for (int y = 0; y < nms.rows; ++y) {
+        const ushort * nmsRow = nms.ptr<ushort>(y);
+        uchar * edgesRow = edges.ptr<uchar>(y);
+        for (int x = 0; x < nms.cols; ++x) {
+            if (edgeList != nullptr and nmsRow[x] > lowTH)
+                candidates.push_back({x, y, dir.ptr<uchar>(y)[x], nmsRow[x]});
+
+            if (nmsRow[x] <= highTH or edgesRow[x] != 0)
+                continue;
+
+            // Flood the weak pixels reachable from this strong seed.
+            edgesRow[x] = 255;
+            worklist.emplace_back(x, y);
+            while (not worklist.empty()) {
+                cv::Point p = worklist.back();
+                worklist.pop_back();
+                for (int ny = p.y - 1; ny <= p.y + 1; ++ny) {
+                    const ushort * neighNmsRow = nms.ptr<ushort>(ny);
+                    uchar * neighEdgesRow = edges.ptr<uchar>(ny);
+                    for (int nx = p.x - 1; nx <= p.x + 1; ++nx) {
+                        if (neighNmsRow[nx] > lowTH and neighEdgesRow[nx] == 0) {
+                            neighEdgesRow[nx] = 255;
+                            worklist.emplace_back(nx, ny);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Keep the candidates that the flood reached.
+    if (edgeList != nullptr) {
+        for (const EdgePoint & candidate : candidates)
+            if (edges.ptr<uchar>(candidate.y)[candidate.x] != 0)
+                edgeList->push_back(candidate);
+    }
+}
+
+/**
+ * Finds the root of a union-find node, halving the path on the way.
+ */
+int unionFindRoot(std::vector<int> & parent, int node) {
+    while (parent[node] != node) {
+        parent[node] = parent[parent[node]];
+        node = parent[node];
+    }
+    return node;
+}
+
+/**
+ * Merges the sets of two union-find nodes. The smaller index becomes the root, and the root is
+ * flagged as strong if either set contains a strong pixel.
+ */
+void unionFindMerge(std::vector<int> & parent, std::vector<uchar> & strong, int a, int b) {
+    a = unionFindRoot(parent, a);
+    b = unionFindRoot(parent, b);
+    if (a == b)
+        return;
+    if (a > b)
+        std::swap(a, b);
+    parent[b] = a;
+    strong[a] |= strong[b];
+}
+
+/**
+ * Parallel version of cannyHysteresis with the same output. The image is split into horizontal tiles;
+ * each tile labels its weak pixels (above lowTH) into 8-connected components with union-find, then
+ * the components touching across tile borders are merged, and finally each tile keeps the pixels
+ * whose component contains at least one strong pixel (above highTH).
+ *
+ * When edgeList is given, each tile lists its edges in scan order and the lists are concatenated.
+ *
+ * @param nms      Thinned magnitude (CV_16U) with zero borders.
+ * @param lowTH    Weak threshold (non-negative).
+ * @param highTH   Strong threshold.
+ * @param edges    Output edge map (CV_8U, edges set to 255).
+ * @param numTiles Number of horizontal tiles processed in parallel.
+ * @param edgeList Optional output list of edge pixels.
+ * @param dir      Direction codes (CV_8U, full image size), required when edgeList is given.
+ */
+void cannyHysteresisParallel(const cv::Mat & nms, int lowTH, int highTH, cv::Mat & edges, int numTiles, std::vector<EdgePoint> * edgeList = nullptr, const cv::Mat & dir = cv::Mat()) {
+    CV_Assert(lowTH >= 0);
+    CV_Assert(edgeList == nullptr or dir.size() == nms.size());
+    edges = cv::Mat::zeros(nms.rows, nms.cols, CV_8U);
+    numTiles = std::max(1, std::min(numTiles, nms.rows));
+
+    int cols = nms.cols;
+    std::vector<int> parent((size_t) nms.rows * cols);
+    std::vector<uchar> strong((size_t) nms.rows * cols);
+    auto tileBegin = [&](int tile) { return nms.rows * tile / numTiles; };
+
+    // Step 1: Label each tile independently. Only nodes of the tile are touched, so tiles do not race.
+    cv::parallel_for_(cv::Range(0, numTiles), [&](const cv::Range & range) {
+        for (int tile = range.start; tile < range.end; ++tile) {
+            int rowBegin = tileBegin(tile), rowEnd = tileBegin(tile + 1);
+            for (int y = rowBegin; y < rowEnd; ++y) {
+                const ushort * nmsRow = nms.ptr<ushort>(y);
+                const ushort * upRow = y > rowBegin ? nms.ptr<ushort>(y - 1) : nullptr;
+                for (int x = 0; x < cols; ++x) {
+                    if (nmsRow[x] <= lowTH)
+                        continue;
+
+                    int node = y * cols + x;
+                    parent[node] = node;
+                    strong[node] = nmsRow[x] > highTH;
+
+                    // Neighbours already visited in raster order: left, up-left, up, up-right.
+                    if (nmsRow[x - 1] > lowTH)
+                        unionFindMerge(parent, strong, node, node - 1);
+                    if (upRow != nullptr) {
+                        for (int dx = -1; dx <= 1; ++dx)
+                            if (upRow[x + dx] > lowTH)
+                                unionFindMerge(parent, strong, node, node - cols + dx);
+                    }
+                }
+            }
+        }
+    });
+
+    // Step 2: Merge the components that touch across tile borders.
+    for (int tile = 1; tile < numTiles; ++tile) {
+        int y = tileBegin(tile);
+        const ushort * nmsRow = nms.ptr<ushort>(y);
+        const ushort * upRow = nms.ptr<ushort>(y - 1);
+        for (int x = 0; x < cols; ++x) {
+            if (nmsRow[x] <= lowTH)
+                continue;
+            for (int dx = -1; dx <= 1; ++dx)
+                if (upRow[x + dx] > lowTH)
+                    unionFindMerge(parent, strong, y * cols + x, (y - 1) * cols + x + dx);
+        }
+    }
+
+    // Step 3: Keep the weak pixels whose component is strong. Roots are only read here.
+    std::vector<std::vector<EdgePoint>> tileEdgeLists(edgeList != nullptr ? numTiles : 0);
+    cv::parallel_for_(cv::Range(0, numTiles), [&](const cv::Range & range) {
+        for (int tile = range.start; tile < range.end; ++tile) {
+            for (int y = tileBegin(tile); y < tileBegin(tile + 1); ++y) {
+                const ushort * nmsRow = nms.ptr<ushort>(y);
+                uchar * edgesRow = edges.ptr<uchar>(y);
+                for (int x = 0; x < cols; ++x) {
+                    if (nmsRow[x] <= lowTH)
+                        continue;
+                    int root = y * cols + x;
+                    while (parent[root] != root)
+                        root = parent[root];
+                    if (strong[root]) {
+                        edgesRow[x] = 255;
+                        if (edgeList != nullptr)
+                            tileEdgeLists[tile].push_back({x, y, dir.ptr<uchar>(y)[x], nmsRow[x]});
+                    }
+                }
+            }
+        }
+    });
+
+    for (const std::vector<EdgePoint> & tileEdgeList : tileEdgeLists)
+        edgeList->insert(edgeList->end(), tileEdgeList.begin(), tileEdgeList.end());
+}
+
+/**
+ * Canny edge detection on an already smoothed image with absolute thresholds on the L1 gradient magnitude,
+ * the same convention as cv::Canny. Only the list of edge pixels is returned, in scan order.
+ *
+ * @param img        Input image (CV_8UC1 or CV_8UC3), already blurred.
+ * @param lowTH      Lower threshold for hysteresis thresholding.
+ * @param highTH     Upper threshold for hysteresis thresholding.
+ * @param edgePoints Output list of edge pixels.
+ */
+void cannyEdgePoints(const cv::Mat & img, int lowTH, int highTH, std::vector<EdgePoint> & edgePoints) {
+    cv::Mat magnitude, direction, nonMaximaSuppressed, edgesImg;
+    int minMagnitude, maxMagnitude;
+    cannyGradient(img, magnitude, direction, minMagnitude, maxMagnitude);
+    cannyNonMaxSuppression(magnitude, direction, nonMaximaSuppressed);
+
+    edgePoints.clear();
+    cannyHysteresis(nonMaximaSuppressed, std::max(lowTH, 0), highTH, edgesImg, &edgePoints, direction);
+}
+
+#endif //OPENCVELIM_EDGES_H
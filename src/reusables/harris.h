@@ -0,0 +1,464 @@
+#ifndef OPENCVELIM_HARRIS_H
+#define OPENCVELIM_HARRIS_H
+
+#include <algorithm>
+#include <cfloat>
+#include <functional>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/**
+ * Convolves a row with a 1D kernel centered on each element.
+ *
+ * @param src    First element of the source row, padded by kernel.size() / 2 elements on both sides.
+ * @param dst    Output row.
+ * @param cols   Number of elements to compute.
+ * @param kernel Filter coefficients.
+ */
+void harrisRowFilter(const float * src, float * dst, int cols, const std::vector<float> & kernel) {
+    int half = (int) kernel.size() / 2;
+    std::fill(dst, dst + cols, 0.f);
+    for (int i = 0; i < (int) kernel.size(); ++i) {
+        const float * shifted = src + i - half;
+        float coefficient = kernel[i];
+        for (int x = 0; x < cols; ++x)
+            dst[x] += coefficient * shifted[x];
+    }
+}
+
+/**
+ * Fills the padding on both sides of a row with BORDER_REFLECT_101, as cv::Sobel and cv::GaussianBlur do.
+ *
+ * @param row  First element of the row, with pad writable elements before and after it.
+ * @param cols Number of elements of the row.
+ * @param pad  Number of padding elements on each side.
+ */
+void harrisReflectPadding(float * row, int cols, int pad) {
+    for (int i = 1; i <= pad; ++i) {
+        row[-i] = row[cv::borderInterpolate(-i, cols, cv::BORDER_REFLECT_101)];
+        row[cols - 1 + i] = row[cv::borderInterpolate(cols - 1 + i, cols, cv::BORDER_REFLECT_101)];
+    }
+}
+
+/**
+ * @struct HarrisBuffers
+ * @brief Row buffers of harrisResponse. Keeping them between calls (pyramid levels, video frames) avoids
+ * reallocating them: after the largest image has been processed, the later calls only reuse memory.
+ */
+struct HarrisBuffers {
+    std::vector<float> vertSmooth, vertDeriv, gx, gy;
+    std::vector<float> products;
+    std::vector<float> ring;
+    std::vector<float> sxx, syy, sxy;
+    std::vector<float> response;
+};
+
+/**
+ * Computes the Harris response R = det(M) - k * trace(M)^2 of rows [rowBegin, rowEnd) of a grayscale
+ * image, where M is the structure tensor (Ixx, Iyy, Ixy) smoothed with a Gaussian. Each response row
+ * is handed to onRow as soon as it is ready, so the response never has to be stored as a whole.
+ *
+ * Gradients, products and the separable smoothing are fused row by row: each image row becomes its three
+ * horizontally smoothed products, kept in a ring of blurSize rows, and each output row is the vertical
+ * smoothing of the ring. Only O(width * blurSize) scratch memory is used.
+ * Borders are reflected (BORDER_REFLECT_101) like in cv::Sobel and cv::GaussianBlur.
+ *
+ * @param img       Input image (CV_8U, single channel).
+ * @param rowBegin  First response row to compute.
+ * @param rowEnd    One past the last response row to compute.
+ * @param k         Harris corner detector parameter.
+ * @param sobelSize Size of the Sobel kernel (1, 3, 5 or 7).
+ * @param blurSize  Size of the Gaussian filter kernel.
+ * @param blurSigma Standard deviation for Gaussian blur.
+ * @param onRow     Called with the index and the values of every response row, in order.
+ * @param buffers   Optional row buffers reused across calls.
+ */
+void harrisResponseRows(const cv::Mat & img, int rowBegin, int rowEnd, float k, int sobelSize, int blurSize, float blurSigma,
+                        const std::function<void(int, const float *)> & onRow, HarrisBuffers * buffers = nullptr) {
+    CV_Assert(img.type() == CV_8U);
+    int rows = img.rows, cols = img.cols;
+
+    // Separable kernels: Gx = derivX (x) smoothY, Gy = smoothX (x) derivY, then the Gaussian on both axes.
+    cv::Mat derivXMat, smoothYMat, smoothXMat, derivYMat;
+    cv::getDerivKernels(derivXMat, smoothYMat, 1, 0, sobelSize, false, CV_32F);
+    cv::getDerivKernels(smoothXMat, derivYMat, 0, 1, sobelSize, false, CV_32F);
+    cv::Mat gaussMat = cv::getGaussianKernel(blurSize, blurSigma, CV_32F);
+    auto toVector = [](const cv::Mat & kernel) {
+        return std::vector<float>(kernel.ptr<float>(), kernel.ptr<float>() + kernel.total());
+    };
+    std::vector<float> derivX = toVector(derivXMat), smoothY = toVector(smoothYMat);
+    std::vector<float> smoothX = toVector(smoothXMat), derivY = toVector(derivYMat);
+    std::vector<float> gauss = toVector(gaussMat);
+
+    int pad = (int) std::max({derivX.size(), smoothX.size(), gauss.size()}) / 2;
+    int paddedCols = cols + 2 * pad;
+    int blurHalf = blurSize / 2;
+
+    // Row buffers: vertical Sobel passes, gradient products (padded), and the ring of smoothed products.
+    HarrisBuffers localBuffers;
+    HarrisBuffers & b = buffers != nullptr ? *buffers : localBuffers;
+    b.vertSmooth.resize(paddedCols);
+    b.vertDeriv.resize(paddedCols);
+    b.gx.resize(cols);
+    b.gy.resize(cols);
+    b.products.resize(3 * paddedCols);
+    b.ring.resize((size_t) 3 * blurSize * cols);
+    b.sxx.resize(cols);
+    b.syy.resize(cols);
+    b.sxy.resize(cols);
+    b.response.resize(cols);
+    std::vector<float> & vertSmooth = b.vertSmooth, & vertDeriv = b.vertDeriv, & gx = b.gx, & gy = b.gy;
+    std::vector<float> & products = b.products, & ring = b.ring;
+    std::vector<float> & sxx = b.sxx, & syy = b.syy, & sxy = b.sxy;
+    float * xx = &products[pad];
+    float * yy = &products[paddedCols + pad];
+    float * xy = &products[2 * paddedCols + pad];
+
+    // Accumulates a vertical 1D filter around image row y into dst (unpadded part).
+    auto columnFilter = [&](int y, const std::vector<float> & kernel, float * dst) {
+        int half = (int) kernel.size() / 2;
+        std::fill(dst, dst + cols, 0.f);
+        for (int i = 0; i < (int) kernel.size(); ++i) {
+            const uchar * src = img.ptr<uchar>(cv::borderInterpolate(y + i - half, rows, cv::BORDER_REFLECT_101));
+            float coefficient = kernel[i];
+            for (int x = 0; x < cols; ++x)
+                dst[x] += coefficient * src[x];
+        }
+    };
+
+    // Turns image row y into its horizontally smoothed products, stored in ring slot y % blurSize.
+    auto computeProducts = [&](int y) {
+        columnFilter(y, smoothY, &vertSmooth[pad]);
+        columnFilter(y, derivY, &vertDeriv[pad]);
+        harrisReflectPadding(&vertSmooth[pad], cols, pad);
+        harrisReflectPadding(&vertDeriv[pad], cols, pad);
+        harrisRowFilter(&vertSmooth[pad], gx.data(), cols, derivX);
+        harrisRowFilter(&vertDeriv[pad], gy.data(), cols, smoothX);
+
+        for (int x = 0; x < cols; ++x) {
+            xx[x] = gx[x] * gx[x];
+            yy[x] = gy[x] * gy[x];
+            xy[x] = gx[x] * gy[x];
+        }
+
+        float * slot = &ring[(size_t) 3 * (y % blurSize) * cols];
+        for (int p = 0; p < 3; ++p) {
+            float * product = &products[p * paddedCols + pad];
+            harrisReflectPadding(product, cols, pad);
+            harrisRowFilter(product, slot + p * cols, cols, gauss);
+        }
+    };
+
+    int nextRow = std::max(rowBegin - blurHalf, 0);
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        // Make sure the ring holds every row of the vertical Gaussian window.
+        while (nextRow <= std::min(y + blurHalf, rows - 1))
+            computeProducts(nextRow++);
+
+        std::fill(sxx.begin(), sxx.end(), 0.f);
+        std::fill(syy.begin(), syy.end(), 0.f);
+        std::fill(sxy.begin(), sxy.end(), 0.f);
+        for (int i = 0; i < blurSize; ++i) {
+            int srcRow = cv::borderInterpolate(y + i - blurHalf, rows, cv::BORDER_REFLECT_101);
+            const float * slot = &ring[(size_t) 3 * (srcRow % blurSize) * cols];
+            float coefficient = gauss[i];
+            for (int x = 0; x < cols; ++x) {
+                sxx[x] += coefficient * slot[x];
+                syy[x] += coefficient * slot[cols + x];
+                sxy[x] += coefficient * slot[2 * cols + x];
+            }
+        }
+
+        float * responseRow = b.response.data();
+        for (int x = 0; x < cols; ++x) {
+            float determinant = sxx[x] * syy[x] - sxy[x] * sxy[x];
+            float trace = sxx[x] + syy[x];
+            responseRow[x] = determinant - k * trace * trace;
+        }
+        onRow(y, responseRow);
+    }
+}
+
+/**
+ * Computes the Harris response of a whole grayscale image, see harrisResponseRows.
+ *
+ * @param img       Input image (CV_8U, single channel).
+ * @param response  Output Harris response (CV_32F).
+ * @param k         Harris corner detector parameter.
+ * @param sobelSize Size of the Sobel kernel (1, 3, 5 or 7).
+ * @param blurSize  Size of the Gaussian filter kernel.
+ * @param blurSigma Standard deviation for Gaussian blur.
+ * @param buffers   Optional row buffers reused across calls.
+ */
+void harrisResponse(const cv::Mat & img, cv::Mat & response, float k, int sobelSize, int blurSize, float blurSigma, HarrisBuffers * buffers = nullptr) {
+    response.create(img.rows, img.cols, CV_32F);
+    harrisResponseRows(img, 0, img.rows, k, sobelSize, blurSize, blurSigma, [&](int y, const float * row) {
+        std::copy(row, row + img.cols, response.ptr<float>(y));
+    }, buffers);
+}
+
+/**
+ * Maps a threshold given on the response normalized to [0, 255] (cv::NORM_MINMAX, as the corner
+ * detectors historically did) to the raw response scale.
+ *
+ * @param threshTH    Threshold in the normalized range.
+ * @param minResponse Smallest raw response.
+ * @param maxResponse Largest raw response.
+ *
+ * @return Raw threshold: a response above it would have been normalized above threshTH.
+ */
+float harrisRawThreshold(int threshTH, double minResponse, double maxResponse) {
+    return (float) (minResponse + (threshTH + 0.5) * (maxResponse - minResponse) / 255.0);
+}
+
+/**
+ * Checks whether a response value is the maximum of its (2 * nmsRadius + 1)^2 neighbourhood, clipped to
+ * the image. Ties are broken in scan order: an equal value before the pixel suppresses it.
+ *
+ * @param rowAt     Callable returning a pointer to a response row.
+ * @param size      Size of the response.
+ * @param y         Row of the pixel.
+ * @param x         Column of the pixel.
+ * @param nmsRadius Radius of the suppression window.
+ */
+template <typename RowAt>
+bool harrisIsLocalMaximum(RowAt rowAt, cv::Size size, int y, int x, int nmsRadius) {
+    float value = rowAt(y)[x];
+    int yEnd = std::min(y + nmsRadius, size.height - 1);
+    int xBegin = std::max(x - nmsRadius, 0), xEnd = std::min(x + nmsRadius, size.width - 1);
+    for (int ny = std::max(y - nmsRadius, 0); ny <= yEnd; ++ny) {
+        const float * neighRow = rowAt(ny);
+        for (int nx = xBegin; nx <= xEnd; ++nx) {
+            bool isBefore = ny < y or (ny == y and nx < x);
+            if (neighRow[nx] > value or (isBefore and neighRow[nx] == value))
+                return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Extracts the corners of a Harris response: the pixels above threshold that are the maximum of their
+ * (2 * nmsRadius + 1) x (2 * nmsRadius + 1) neighbourhood. Ties are broken in scan order, so a flat
+ * maximum gives a single corner. Only pixels above threshold are examined, so the cost follows the
+ * number of candidates rather than the window area of every pixel.
+ *
+ * @param response  Harris response (CV_32F).
+ * @param threshold Raw response threshold.
+ * @param nmsRadius Radius of the suppression window (default is 1, i.e. 3x3).
+ *
+ * @return The corners in scan order, with the response stored in KeyPoint::response.
+ */
+std::vector<cv::KeyPoint> harrisNonMaxSuppression(const cv::Mat & response, float threshold, int nmsRadius = 1) {
+    CV_Assert(response.type() == CV_32F);
+    std::vector<cv::KeyPoint> corners;
+    for (int y = 0; y < response.rows; ++y) {
+        const float * responseRow = response.ptr<float>(y);
+        for (int x = 0; x < response.cols; ++x) {
+            float value = responseRow[x];
+            if (value <= threshold)
+                continue;
+
+            auto rowAt = [&](int ny) { return response.ptr<float>(ny); };
+            if (harrisIsLocalMaximum(rowAt, response.size(), y, x, nmsRadius))
+                corners.emplace_back((float) x, (float) y, (float) (2 * nmsRadius + 1), -1.f, value);
+        }
+    }
+    return corners;
+}
+
+/**
+ * Keeps at most maxCorners corners, the strongest ones. With gridCells > 1 the image is divided into a
+ * gridCells x gridCells grid and each cell first gets an equal share of the budget, so that corners stay
+ * spread over the image; the budget left unused by sparse cells goes to the strongest remaining corners.
+ *
+ * @param corners    Corners to filter, in place.
+ * @param imgSize    Size of the image the corners come from.
+ * @param maxCorners Maximum number of corners to keep (0 keeps all of them).
+ * @param gridCells  Number of grid cells per side (default is 1, no bucketing).
+ */
+void harrisSelectCorners(std::vector<cv::KeyPoint> & corners, cv::Size imgSize, int maxCorners, int gridCells = 1) {
+    if (maxCorners <= 0 or (int) corners.size() <= maxCorners)
+        return;
+
+    auto isStronger = [](const cv::KeyPoint & a, const cv::KeyPoint & b) { return a.response > b.response; };
+    auto keepStrongest = [&](std::vector<cv::KeyPoint> & keypoints, int count) {
+        count = std::min(count, (int) keypoints.size());
+        std::partial_sort(keypoints.begin(), keypoints.begin() + count, keypoints.end(), isStronger);
+        keypoints.resize(count);
+    };
+
+    if (gridCells <= 1) {
+        keepStrongest(corners, maxCorners);
+        return;
+    }
+
+    // Step 1: Bucket the corners into the grid cells.
+    std::vector<std::vector<cv::KeyPoint>> cells(gridCells * gridCells);
+    for (const cv::KeyPoint & corner : corners) {
+        int cellX = std::min((int) corner.pt.x * gridCells / imgSize.width, gridCells - 1);
+        int cellY = std::min((int) corner.pt.y * gridCells / imgSize.height, gridCells - 1);
+        cells.at(cellY * gridCells + cellX).push_back(corner);
+    }
+
+    // Step 2: Take the strongest corners of each cell, up to its share of the budget.
+    int cellShare = std::max(1, maxCorners / (gridCells * gridCells));
+    std::vector<cv::KeyPoint> selected, leftovers;
+    for (std::vector<cv::KeyPoint> & cell : cells) {
+        int count = std::min(cellShare, (int) cell.size());
+        std::partial_sort(cell.begin(), cell.begin() + count, cell.end(), isStronger);
+        selected.insert(selected.end(), cell.begin(), cell.begin() + count);
+        leftovers.insert(leftovers.end(), cell.begin() + count, cell.end());
+    }
+
+    // Step 3: Trim or fill the selection to exactly maxCorners.
+    if ((int) selected.size() >= maxCorners) {
+        keepStrongest(selected, maxCorners);
+    } else {
+        keepStrongest(leftovers, maxCorners - (int) selected.size());
+        selected.insert(selected.end(), leftovers.begin(), leftovers.end());
+    }
+    corners = selected;
+}
+
+/**
+ * Draws corners on a copy of an image.
+ *
+ * @param img     Image to draw on.
+ * @param corners Corners to mark with a circle.
+ *
+ * @return A copy of img with the corners drawn.
+ */
+cv::Mat harrisDrawCorners(const cv::Mat & img, const std::vector<cv::KeyPoint> & corners) {
+    cv::Mat out = img.clone();
+    for (const cv::KeyPoint & corner : corners)
+        cv::circle(out, cv::Point(cvRound(corner.pt.x), cvRound(corner.pt.y)), 3, cv::Scalar(255), 1, 8, 0);
+    return out;
+}
+
+/**
+ * @struct HarrisPyramid
+ * @brief Image pyramid of the multi-scale Harris detector with its responses and row buffers.
+ * The same object can be passed to successive detections: levels of unchanged size are not reallocated.
+ */
+struct HarrisPyramid {
+    std::vector<cv::Mat> levels;     // levels[0] is the input image (not copied), each level half the previous one.
+    std::vector<cv::Mat> responses;  // Harris response of each level.
+    HarrisBuffers buffers;
+};
+
+/**
+ * Fills a pyramid with numOctaves levels of an image, halving the size at each level with cv::pyrDown.
+ * Levels are written into the existing matrices, so rebuilding a pyramid for a same-sized image
+ * allocates nothing. Building stops early if a level would become smaller than minSize pixels per side.
+ *
+ * @param img        Input image (level 0).
+ * @param pyramid    Pyramid to fill.
+ * @param numOctaves Maximum number of levels.
+ * @param minSize    Minimum side of a level (default is 16).
+ */
+void harrisBuildPyramid(const cv::Mat & img, HarrisPyramid & pyramid, int numOctaves, int minSize = 16) {
+    int numLevels = 1;
+    cv::Size levelSize = img.size();
+    while (numLevels < numOctaves and std::min(levelSize.width, levelSize.height) / 2 >= minSize) {
+        levelSize = cv::Size((levelSize.width + 1) / 2, (levelSize.height + 1) / 2);
+        numLevels++;
+    }
+
+    pyramid.levels.resize(numLevels);
+    pyramid.responses.resize(numLevels);
+    pyramid.levels.at(0) = img;
+    for (int level = 1; level < numLevels; ++level) {
+        cv::Mat & previous = pyramid.levels.at(level - 1);
+        cv::Size size((previous.cols + 1) / 2, (previous.rows + 1) / 2);
+        pyramid.levels.at(level).create(size, img.type());
+        cv::pyrDown(previous, pyramid.levels.at(level), size);
+    }
+}
+
+/**
+ * Number of extra image rows a band needs on each side so that harrisStreamCorners gives, for the rows
+ * of the band, the same corners as on the whole image: Sobel and Gaussian radii plus the NMS radius.
+ */
+int harrisHaloRows(int sobelSize, int blurSize, int nmsRadius) {
+    return std::max(sobelSize / 2, 1) + blurSize / 2 + nmsRadius;
+}
+
+/**
+ * Estimates the raw threshold equivalent to a threshold on the response normalized to [0, 255], without
+ * storing the response: the response range is tracked while streaming it. With sampleEvery > 1 only one
+ * band of 16 rows out of every sampleEvery is computed, trading exactness for speed.
+ *
+ * @param img         Input image (CV_8U, single channel).
+ * @param threshTH    Threshold on the normalized response.
+ * @param k           Harris corner detector parameter.
+ * @param sobelSize   Size of the Sobel kernel.
+ * @param blurSize    Size of the Gaussian filter kernel.
+ * @param blurSigma   Standard deviation for Gaussian blur.
+ * @param sampleEvery Band sampling step (default is 1, the exact range).
+ *
+ * @return Absolute threshold on R, see harrisRawThreshold.
+ */
+float harrisCalibrateThreshold(const cv::Mat & img, int threshTH, float k, int sobelSize, int blurSize, float blurSigma, int sampleEvery = 1) {
+    const int bandRows = 16;
+    float minResponse = FLT_MAX, maxResponse = -FLT_MAX;
+    HarrisBuffers buffers;
+    for (int bandBegin = 0; bandBegin < img.rows; bandBegin += bandRows * std::max(sampleEvery, 1)) {
+        int bandEnd = std::min(bandBegin + bandRows, img.rows);
+        harrisResponseRows(img, bandBegin, bandEnd, k, sobelSize, blurSize, blurSigma, [&](int, const float * row) {
+            for (int x = 0; x < img.cols; ++x) {
+                minResponse = std::min(minResponse, row[x]);
+                maxResponse = std::max(maxResponse, row[x]);
+            }
+        }, &buffers);
+    }
+    return harrisRawThreshold(threshTH, minResponse, maxResponse);
+}
+
+/**
+ * Streaming Harris detection with an absolute threshold on R: corners of rows [rowBegin, rowEnd) are
+ * emitted row by row, as soon as the response rows of their suppression window are available. Only a
+ * window of 2 * nmsRadius + 1 response rows is kept, and no normalization pass is needed.
+ *
+ * img can be a band of a larger image, read with harrisHaloRows() extra rows on each side: the corners of
+ * the band rows are then the same as on the whole image, in band coordinates.
+ *
+ * @param img       Input image (CV_8U, single channel).
+ * @param rowBegin  First row whose corners are emitted.
+ * @param rowEnd    One past the last row whose corners are emitted.
+ * @param k         Harris corner detector parameter.
+ * @param sobelSize Size of the Sobel kernel.
+ * @param blurSize  Size of the Gaussian filter kernel.
+ * @param blurSigma Standard deviation for Gaussian blur.
+ * @param threshold Absolute threshold on R.
+ * @param nmsRadius Radius of the suppression window.
+ * @param onCorner  Called for every corner, in scan order.
+ * @param buffers   Optional row buffers reused across calls.
+ */
+void harrisStreamCorners(const cv::Mat & img, int rowBegin, int rowEnd, float k, int sobelSize, int blurSize, float blurSigma,
+                         float threshold, int nmsRadius, const std::function<void(const cv::KeyPoint &)> & onCorner,
+                         HarrisBuffers * buffers = nullptr) {
+    int cols = img.cols;
+    int windowRows = 2 * nmsRadius + 1;
+    std::vector<float> window((size_t) windowRows * cols);
+    auto rowAt = [&](int y) { return &window[(size_t) (y % windowRows) * cols]; };
+
+    int nextEmitted = rowBegin;
+    int responseBegin = std::max(rowBegin - nmsRadius, 0);
+    int responseEnd = std::min(rowEnd + nmsRadius, img.rows);
+    harrisResponseRows(img, responseBegin, responseEnd, k, sobelSize, blurSize, blurSigma, [&](int y, const float * row) {
+        std::copy(row, row + cols, rowAt(y));
+
+        // Emit the rows whose whole suppression window has been computed.
+        while (nextEmitted < rowEnd and std::min(nextEmitted + nmsRadius, img.rows - 1) <= y) {
+            const float * emittedRow = rowAt(nextEmitted);
+            for (int x = 0; x < cols; ++x) {
+                if (emittedRow[x] > threshold and harrisIsLocalMaximum(rowAt, img.size(), nextEmitted, x, nmsRadius))
+                    onCorner(cv::KeyPoint((float) x, (float) nextEmitted, (float) windowRows, -1.f, emittedRow[x]));
+            }
+            nextEmitted++;
+        }
+    }, buffers);
+}
+
+#endif //OPENCVELIM_HARRIS_H
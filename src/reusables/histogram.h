@@ -0,0 +1,121 @@
+#ifndef OPENCVELIM_HISTOGRAM_H
+#define OPENCVELIM_HISTOGRAM_H
+
+#include <algorithm>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+// Number of bins of an 8 bit histogram.
+#define HISTOGRAM_BINS 256
+
+// Number of bins of a 16 bit histogram.
+#define HISTOGRAM_BINS_16U 65536
+
+// Number of interleaved sub-histograms: consecutive pixels with the same value increment different
+// counters, so the increments do not wait on each other (store-to-load forwarding stalls).
+#define HISTOGRAM_LANES 4
+
+/**
+ * Accumulates the histogram of rows [rowBegin, rowEnd) of an 8 bit image into hist.
+ *
+ * Rows are read through row pointers, four pixels per step, each pixel of a step going to its own
+ * sub-histogram; the sub-histograms are summed at the end.
+ *
+ * @param img      Input image (CV_8U, single channel). Can be a ROI.
+ * @param rowBegin First row.
+ * @param rowEnd   One past the last row.
+ * @param mask     Optional mask (CV_8U, same size): only the pixels where it is non-zero are counted.
+ * @param hist     Histogram of HISTOGRAM_BINS counters the counts are added to.
+ */
+void histogramRows(const cv::Mat & img, int rowBegin, int rowEnd, const cv::Mat & mask, int * hist) {
+    int lanes[HISTOGRAM_LANES][HISTOGRAM_BINS] = {};
+    int cols = img.cols;
+
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        const uchar * imgRow = img.ptr<uchar>(y);
+        if (mask.empty()) {
+            int x = 0;
+            for (; x + HISTOGRAM_LANES <= cols; x += HISTOGRAM_LANES) {
+                lanes[0][imgRow[x]]++;
+                lanes[1][imgRow[x + 1]]++;
+                lanes[2][imgRow[x + 2]]++;
+                lanes[3][imgRow[x + 3]]++;
+            }
+            for (; x < cols; ++x)
+                lanes[0][imgRow[x]]++;
+        } else {
+            const uchar * maskRow = mask.ptr<uchar>(y);
+            for (int x = 0; x < cols; ++x) {
+                // Branch-free: masked out pixels add zero.
+                lanes[x & (HISTOGRAM_LANES - 1)][imgRow[x]] += maskRow[x] != 0;
+            }
+        }
+    }
+
+    for (int bin = 0; bin < HISTOGRAM_BINS; ++bin)
+        hist[bin] += lanes[0][bin] + lanes[1][bin] + lanes[2][bin] + lanes[3][bin];
+}
+
+/**
+ * Accumulates the histogram of rows [rowBegin, rowEnd) of a 16 bit image into hist. With 65536 bins
+ * repeated values rarely hit the same counter back to back, so a single histogram is used.
+ *
+ * @param img      Input image (CV_16U, single channel). Can be a ROI.
+ * @param rowBegin First row.
+ * @param rowEnd   One past the last row.
+ * @param mask     Optional mask (CV_8U, same size): only the pixels where it is non-zero are counted.
+ * @param hist     Histogram of HISTOGRAM_BINS_16U counters the counts are added to.
+ */
+void histogramRows16(const cv::Mat & img, int rowBegin, int rowEnd, const cv::Mat & mask, int * hist) {
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        const ushort * imgRow = img.ptr<ushort>(y);
+        const uchar * maskRow = mask.empty() ? nullptr : mask.ptr<uchar>(y);
+        for (int x = 0; x < img.cols; ++x)
+            hist[imgRow[x]] += maskRow == nullptr or maskRow[x] != 0;
+    }
+}
+
+/**
+ * Computes the histogram of an 8 or 16 bit image with integer counts.
+ *
+ * With numStripes > 1 the image is split in horizontal stripes, histogrammed in parallel into private
+ * histograms that are merged at the end. A ROI is histogrammed by passing the ROI view (cv::Mat(img, rect)).
+ *
+ * @param img        Input image (CV_8U or CV_16U, single channel).
+ * @param hist       Output histogram of HISTOGRAM_BINS (8 bit) or HISTOGRAM_BINS_16U (16 bit) counts.
+ * @param mask       Optional mask (CV_8U, same size): only the pixels where it is non-zero are counted.
+ * @param numStripes Number of stripes histogrammed in parallel (default is 1).
+ *
+ * @return The number of counted pixels.
+ */
+int computeHistogram(const cv::Mat & img, std::vector<int> & hist, const cv::Mat & mask = cv::Mat(), int numStripes = 1) {
+    CV_Assert(img.type() == CV_8U or img.type() == CV_16U);
+    CV_Assert(mask.empty() or (mask.type() == CV_8U and mask.size() == img.size()));
+    bool is16U = img.type() == CV_16U;
+    int numBins = is16U ? HISTOGRAM_BINS_16U : HISTOGRAM_BINS;
+
+    numStripes = std::max(1, std::min(numStripes, img.rows));
+    std::vector<std::vector<int>> stripeHists(numStripes, std::vector<int>(numBins, 0));
+    cv::parallel_for_(cv::Range(0, numStripes), [&](const cv::Range & range) {
+        for (int stripe = range.start; stripe < range.end; ++stripe) {
+            int rowBegin = stripe * img.rows / numStripes;
+            int rowEnd = (stripe + 1) * img.rows / numStripes;
+            if (is16U)
+                histogramRows16(img, rowBegin, rowEnd, mask, stripeHists[stripe].data());
+            else
+                histogramRows(img, rowBegin, rowEnd, mask, stripeHists[stripe].data());
+        }
+    });
+
+    hist.assign(numBins, 0);
+    int numPixels = 0;
+    for (const std::vector<int> & stripeHist : stripeHists) {
+        for (int bin = 0; bin < numBins; ++bin) {
+            hist[bin] += stripeHist[bin];
+            numPixels += stripeHist[bin];
+        }
+    }
+    return numPixels;
+}
+
+#endif //OPENCVELIM_HISTOGRAM_H
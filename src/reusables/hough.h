@@ -0,0 +1,867 @@
+#ifndef OPENCVELIM_HOUGH_H
+#define OPENCVELIM_HOUGH_H
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "edges.h"
+
+// Fixed point precision of the sin/cos tables (Q16).
+#define HOUGH_TRIG_SHIFT 16
+
+// Number of edge points whose rho is computed in one go by the voting loop.
+#define HOUGH_VOTE_BLOCK 1024
+
+/**
+ * @struct HoughTrigTable
+ * @brief cos and sin of the line normal for every theta bin, in Q16 fixed point.
+ *
+ * Theta bin t is the angle t * pi / numTheta (radians), so numTheta sets the angular resolution.
+ */
+struct HoughTrigTable {
+    int numTheta;
+    std::vector<int> cosTable;
+    std::vector<int> sinTable;
+};
+
+/**
+ * Builds the fixed point sin/cos table of numTheta bins over [0, pi).
+ *
+ * @param numTheta Number of theta bins (180 gives a resolution of 1 degree).
+ *
+ * @return The table.
+ */
+HoughTrigTable houghTrigTable(int numTheta) {
+    CV_Assert(numTheta > 0);
+    HoughTrigTable table;
+    table.numTheta = numTheta;
+    table.cosTable.resize(numTheta);
+    table.sinTable.resize(numTheta);
+    for (int t = 0; t < numTheta; ++t) {
+        double theta = t * CV_PI / numTheta;
+        table.cosTable[t] = cvRound(std::cos(theta) * (1 << HOUGH_TRIG_SHIFT));
+        table.sinTable[t] = cvRound(std::sin(theta) * (1 << HOUGH_TRIG_SHIFT));
+    }
+    return table;
+}
+
+/**
+ * Returns the angle in radians of a theta bin.
+ */
+double houghTheta(int thetaIdx, int numTheta) {
+    return thetaIdx * CV_PI / numTheta;
+}
+
+/**
+ * Returns the rho bin of rho = 0, i.e. the offset that makes all the rho bins of an image non-negative.
+ * The accumulator has 2 * houghRhoOffset(size) + 1 rho bins.
+ */
+int houghRhoOffset(cv::Size imgSize) {
+    return cvCeil(std::hypot(imgSize.width, imgSize.height));
+}
+
+/**
+ * Votes the lines through a range of edge points for a single theta bin.
+ *
+ * rho is computed for a block of points in a branch-free fixed point loop that the compiler can vectorize
+ * (points are kept as separate x and y arrays), then the votes are scattered in the accumulator row.
+ *
+ * @tparam T        Vote counter type.
+ * @param x         x coordinates of the edge points.
+ * @param y         y coordinates of the edge points.
+ * @param numPoints Number of edge points.
+ * @param table     Trig table of the theta bins.
+ * @param rhoOffset Rho bin of rho = 0, see houghRhoOffset.
+ * @param theta     Theta bin to vote.
+ * @param votesRow  Accumulator row of the theta bin.
+ */
+template <typename T>
+void houghVoteTheta(const int * x, const int * y, int numPoints, const HoughTrigTable & table, int rhoOffset, int theta, T * votesRow) {
+    int rhoIdx[HOUGH_VOTE_BLOCK];
+    int c = table.cosTable[theta], s = table.sinTable[theta];
+
+    // Rounding and the rho offset are folded in a single bias, so the sum is never negative and the
+    // shift gives the rounded rho bin directly.
+    int bias = (rhoOffset << HOUGH_TRIG_SHIFT) + (1 << (HOUGH_TRIG_SHIFT - 1));
+
+    for (int blockBegin = 0; blockBegin < numPoints; blockBegin += HOUGH_VOTE_BLOCK) {
+        int blockSize = std::min(HOUGH_VOTE_BLOCK, numPoints - blockBegin);
+        const int * bx = x + blockBegin;
+        const int * by = y + blockBegin;
+        for (int i = 0; i < blockSize; ++i)
+            rhoIdx[i] = (bx[i] * c + by[i] * s + bias) >> HOUGH_TRIG_SHIFT;
+        for (int i = 0; i < blockSize; ++i)
+            votesRow[rhoIdx[i]]++;
+    }
+}
+
+/**
+ * Votes the theta bins [thetaBegin, thetaEnd) of a theta-major accumulator, one row at a time so that the
+ * row stays in cache for the whole theta.
+ *
+ * Without thetaBuckets every point votes every theta. With thetaBuckets the points are sorted by the theta
+ * bin of their gradient, bucket b being [thetaBuckets[b], thetaBuckets[b + 1]), and theta t is voted only
+ * by the buckets within deltaTheta bins of t (wrapping around pi), which are contiguous ranges of points.
+ *
+ * @tparam T            Vote counter type.
+ * @param xs            x coordinates of the edge points.
+ * @param ys            y coordinates of the edge points.
+ * @param table         Trig table of the theta bins.
+ * @param rhoOffset     Rho bin of rho = 0, see houghRhoOffset.
+ * @param votes         Accumulator, numTheta rows of 2 * rhoOffset + 1 rho bins.
+ * @param thetaBegin    First theta bin to vote.
+ * @param thetaEnd      One past the last theta bin to vote.
+ * @param thetaBuckets  Optional start of each theta bucket in xs and ys (numTheta + 1 entries).
+ * @param deltaTheta    Maximum distance in bins between a voted theta and the gradient of the point.
+ */
+template <typename T>
+void houghVoteLinesRange(const std::vector<int> & xs, const std::vector<int> & ys, const HoughTrigTable & table, int rhoOffset,
+                         cv::Mat & votes, int thetaBegin, int thetaEnd, const std::vector<int> * thetaBuckets = nullptr, int deltaTheta = 0) {
+    int numTheta = table.numTheta;
+    for (int t = thetaBegin; t < thetaEnd; ++t) {
+        T * votesRow = votes.ptr<T>(t);
+        if (thetaBuckets == nullptr) {
+            houghVoteTheta(xs.data(), ys.data(), (int) xs.size(), table, rhoOffset, t, votesRow);
+            continue;
+        }
+
+        // Buckets t - deltaTheta .. t + deltaTheta, split in two ranges when they wrap around pi.
+        int first = t - deltaTheta, last = t + deltaTheta + 1;
+        int ranges[2][2] = {{std::max(first, 0), std::min(last, numTheta)}, {0, 0}};
+        if (first < 0) {
+            ranges[1][0] = first + numTheta;
+            ranges[1][1] = numTheta;
+        } else if (last > numTheta) {
+            ranges[1][0] = 0;
+            ranges[1][1] = last - numTheta;
+        }
+
+        for (auto & range : ranges) {
+            int pointBegin = (*thetaBuckets)[range[0]], pointEnd = (*thetaBuckets)[range[1]];
+            if (range[0] < range[1])
+                houghVoteTheta(xs.data() + pointBegin, ys.data() + pointBegin, pointEnd - pointBegin, table, rhoOffset, t, votesRow);
+        }
+    }
+}
+
+/**
+ * Row pointer gather of houghEdgeGradients for an image with cn interleaved channels.
+ */
+template <int cn>
+void houghEdgeGradientsT(const cv::Mat & img, const std::vector<EdgePoint> & edgePoints, std::vector<cv::Point> & gradients) {
+    gradients.resize(edgePoints.size());
+    for (size_t i = 0; i < edgePoints.size(); ++i) {
+        int x = edgePoints[i].x, y = edgePoints[i].y;
+        const uchar * up = img.ptr<uchar>(cv::borderInterpolate(y - 1, img.rows, cv::BORDER_REFLECT_101));
+        const uchar * cur = img.ptr<uchar>(y);
+        const uchar * down = img.ptr<uchar>(cv::borderInterpolate(y + 1, img.rows, cv::BORDER_REFLECT_101));
+        int xl = cv::borderInterpolate(x - 1, img.cols, cv::BORDER_REFLECT_101);
+        int xr = cv::borderInterpolate(x + 1, img.cols, cv::BORDER_REFLECT_101);
+        cannyGradientVector<cn>(up, cur, down, xl, x, xr, gradients[i].x, gradients[i].y);
+    }
+}
+
+/**
+ * Computes the gradient of every edge point with the Canny gradient operator (cannyGradientVector): on
+ * BGR images it is the gradient of the strongest channel, the one that made the pixel an edge.
+ * Only the edge pixels are filtered.
+ *
+ * @param img        Image the edges were detected on (CV_8UC1 or CV_8UC3, already blurred).
+ * @param edgePoints Edge points.
+ * @param gradients  Output (Gx, Gy) of each edge point.
+ */
+void houghEdgeGradients(const cv::Mat & img, const std::vector<EdgePoint> & edgePoints, std::vector<cv::Point> & gradients) {
+    CV_Assert(img.type() == CV_8UC1 or img.type() == CV_8UC3);
+    if (img.channels() == 3)
+        houghEdgeGradientsT<3>(img, edgePoints, gradients);
+    else
+        houghEdgeGradientsT<1>(img, edgePoints, gradients);
+}
+
+/**
+ * Computes the theta bin of the gradient of every edge point, i.e. the normal of the line through it.
+ *
+ * @param img        Image the edges were detected on (CV_8UC1 or CV_8UC3, already blurred).
+ * @param edgePoints Edge points.
+ * @param numTheta   Number of theta bins over [0, pi).
+ * @param thetas     Output theta bin of each edge point.
+ */
+void houghEdgeThetas(const cv::Mat & img, const std::vector<EdgePoint> & edgePoints, int numTheta, std::vector<int> & thetas) {
+    std::vector<cv::Point> gradients;
+    houghEdgeGradients(img, edgePoints, gradients);
+    thetas.resize(edgePoints.size());
+    for (size_t i = 0; i < edgePoints.size(); ++i) {
+        // The gradient and its opposite give the same line, so the angle is folded in [0, pi).
+        double theta = std::atan2((double) gradients[i].y, (double) gradients[i].x);
+        if (theta < 0)
+            theta += CV_PI;
+        thetas[i] = cvRound(theta * numTheta / CV_PI) % numTheta;
+    }
+}
+
+/**
+ * Hough transform for lines: votes every (theta, rho) bin of the lines through the edge points.
+ *
+ * The accumulator has one row per theta bin and one column per rho bin (rho = column - houghRhoOffset).
+ * A bin can get at most one vote per edge point, so the counters are CV_16U when there are fewer than
+ * 65536 points and CV_32S otherwise: they never wrap.
+ *
+ * With numSlices > 1 the theta bins are split in slices voted in parallel. Every slice owns its rows of
+ * the accumulator, so no private copies or reduction are needed and the result is the same as the serial
+ * voting for any number of slices.
+ *
+ * With edgeThetas (see houghEdgeThetas) each point votes only the theta bins within deltaTheta bins of its
+ * gradient instead of all of them. The accumulator has the same layout as with full voting.
+ *
+ * @param edgePoints Edge points, in image coordinates.
+ * @param imgSize    Size of the image.
+ * @param table      Trig table of the theta bins.
+ * @param votes      Output accumulator (CV_16U or CV_32S).
+ * @param numSlices  Number of theta slices voted in parallel (default is 1).
+ * @param edgeThetas Optional gradient theta bin of each edge point.
+ * @param deltaTheta Maximum distance in bins between a voted theta and the gradient (default is 0).
+ */
+void houghVoteLines(const std::vector<EdgePoint> & edgePoints, cv::Size imgSize, const HoughTrigTable & table, cv::Mat & votes,
+                    int numSlices = 1, const std::vector<int> * edgeThetas = nullptr, int deltaTheta = 0) {
+    int rhoOffset = houghRhoOffset(imgSize);
+    int numTheta = table.numTheta;
+    // Keeps the fixed point sums of the voting loop within 31 bits.
+    CV_Assert(2 * rhoOffset + 1 < (INT_MAX >> HOUGH_TRIG_SHIFT));
+
+    std::vector<int> xs(edgePoints.size()), ys(edgePoints.size());
+    std::vector<int> thetaBuckets;
+    if (edgeThetas != nullptr and 2 * deltaTheta + 1 < numTheta) {
+        // Counting sort of the points by gradient theta, so each theta bucket is a contiguous range.
+        thetaBuckets.assign(numTheta + 1, 0);
+        for (int theta : *edgeThetas)
+            thetaBuckets[theta + 1]++;
+        for (int t = 0; t < numTheta; ++t)
+            thetaBuckets[t + 1] += thetaBuckets[t];
+        std::vector<int> next(thetaBuckets.begin(), thetaBuckets.end() - 1);
+        for (size_t i = 0; i < edgePoints.size(); ++i) {
+            int dst = next[(*edgeThetas)[i]]++;
+            xs[dst] = edgePoints[i].x;
+            ys[dst] = edgePoints[i].y;
+        }
+    } else {
+        for (size_t i = 0; i < edgePoints.size(); ++i) {
+            xs[i] = edgePoints[i].x;
+            ys[i] = edgePoints[i].y;
+        }
+    }
+    const std::vector<int> * buckets = thetaBuckets.empty() ? nullptr : &thetaBuckets;
+
+    bool wideVotes = edgePoints.size() > USHRT_MAX;
+    votes = cv::Mat::zeros(numTheta, 2 * rhoOffset + 1, wideVotes ? CV_32S : CV_16U);
+    numSlices = std::max(1, std::min(numSlices, numTheta));
+    cv::parallel_for_(cv::Range(0, numSlices), [&](const cv::Range & range) {
+        for (int slice = range.start; slice < range.end; ++slice) {
+            int thetaBegin = slice * numTheta / numSlices;
+            int thetaEnd = (slice + 1) * numTheta / numSlices;
+            if (wideVotes)
+                houghVoteLinesRange<int>(xs, ys, table, rhoOffset, votes, thetaBegin, thetaEnd, buckets, deltaTheta);
+            else
+                houghVoteLinesRange<ushort>(xs, ys, table, rhoOffset, votes, thetaBegin, thetaEnd, buckets, deltaTheta);
+        }
+    });
+}
+
+/**
+ * @struct HoughLine
+ * @brief A line found by the Hough transform: x * cos(theta) + y * sin(theta) = rho.
+ */
+struct HoughLine {
+    float rho;      // Distance from the origin, in pixels (can be negative).
+    float theta;    // Angle of the normal, in radians in [0, pi).
+    int votes;      // Votes of the accumulator bin.
+};
+
+/**
+ * Extracts the peaks of a line accumulator, see houghLinePeaks.
+ *
+ * @tparam T Vote counter type.
+ */
+template <typename T>
+std::vector<HoughLine> houghLinePeaksT(const cv::Mat & votes, int minVotes, int nmsRadius) {
+    int numTheta = votes.rows, numRho = votes.cols;
+    std::vector<HoughLine> lines;
+    for (int t = 0; t < numTheta; ++t) {
+        const T * votesRow = votes.ptr<T>(t);
+        for (int r = 0; r < numRho; ++r) {
+            int count = votesRow[r];
+            if (count < minVotes)
+                continue;
+
+            // A bin is a peak if no bin of its neighbourhood has more votes (or as many, earlier in
+            // scan order). Past theta = 0 or pi the neighbours wrap around with the opposite rho.
+            bool isPeak = true;
+            for (int dt = -nmsRadius; dt <= nmsRadius and isPeak; ++dt) {
+                int nt = t + dt, nr = r;
+                if (nt < 0 or nt >= numTheta) {
+                    nt = (nt + numTheta) % numTheta;
+                    nr = numRho - 1 - r;
+                }
+                const T * neighRow = votes.ptr<T>(nt);
+                for (int dr = -nmsRadius; dr <= nmsRadius; ++dr) {
+                    int nrr = nr + (nt == t + dt ? dr : -dr);
+                    if (nrr < 0 or nrr >= numRho or (dt == 0 and dr == 0))
+                        continue;
+                    bool isBefore = nt < t or (nt == t and nrr < r);
+                    if ((int) neighRow[nrr] > count or (isBefore and (int) neighRow[nrr] == count)) {
+                        isPeak = false;
+                        break;
+                    }
+                }
+            }
+
+            if (isPeak)
+                lines.push_back({(float) (r - numRho / 2), (float) houghTheta(t, numTheta), count});
+        }
+    }
+    return lines;
+}
+
+/**
+ * Extracts the lines of a line accumulator: the bins with at least minVotes votes that are the maximum of
+ * their (2 * nmsRadius + 1)^2 neighbourhood, so that each line gives a single peak instead of a smear of
+ * near-duplicate bins. With maxLines > 0 only the maxLines lines with the most votes are kept (partial sort).
+ *
+ * @param votes     Accumulator of houghVoteLines (CV_16U or CV_32S).
+ * @param minVotes  Minimum number of votes.
+ * @param nmsRadius Radius of the suppression window, in bins.
+ * @param maxLines  Maximum number of lines to return (default is 0, no limit).
+ *
+ * @return The lines, sorted by decreasing votes when maxLines is set and in theta-major order otherwise.
+ */
+std::vector<HoughLine> houghLinePeaks(const cv::Mat & votes, int minVotes, int nmsRadius, int maxLines = 0) {
+    std::vector<HoughLine> lines = votes.type() == CV_16U ? houghLinePeaksT<ushort>(votes, minVotes, nmsRadius)
+                                                          : houghLinePeaksT<int>(votes, minVotes, nmsRadius);
+
+    if (maxLines > 0 and (int) lines.size() > maxLines) {
+        std::partial_sort(lines.begin(), lines.begin() + maxLines, lines.end(), [](const HoughLine & a, const HoughLine & b) {
+            return a.votes > b.votes;
+        });
+        lines.resize(maxLines);
+    }
+    return lines;
+}
+
+/**
+ * Draws lines found by the Hough transform across the whole image.
+ *
+ * @param img       Image to draw on.
+ * @param lines     Lines to draw.
+ * @param color     Color of the lines.
+ * @param thickness Thickness of the lines.
+ * @param lineType  Type of the lines (see cv::LineTypes).
+ */
+void houghDrawLines(cv::Mat & img, const std::vector<HoughLine> & lines, const cv::Scalar & color, int thickness = 2, int lineType = cv::LINE_8) {
+    int lineOffset = 2 * houghRhoOffset(img.size());
+    for (const HoughLine & line : lines) {
+        double cosTheta = std::cos(line.theta), sinTheta = std::sin(line.theta);
+        double x0 = line.rho * cosTheta, y0 = line.rho * sinTheta;
+
+        // Finding two points to draw the line
+        cv::Point point1(cvRound(x0 - lineOffset * sinTheta), cvRound(y0 + lineOffset * cosTheta));
+        cv::Point point2(cvRound(x0 + lineOffset * sinTheta), cvRound(y0 - lineOffset * cosTheta));
+        cv::line(img, point1, point2, color, thickness, lineType);
+    }
+}
+
+// States of the edge pixels during the progressive probabilistic Hough transform.
+#define HOUGH_PIXEL_FREE 0      // Not an edge pixel, or already assigned to a segment.
+#define HOUGH_PIXEL_PENDING 1   // Edge pixel that has not voted yet.
+#define HOUGH_PIXEL_VOTED 2     // Edge pixel whose votes are in the accumulator.
+
+/**
+ * Adds (sign = 1) or removes (sign = -1) the votes of an edge point for every theta bin.
+ *
+ * @return The theta bin whose bin of the point has the most votes, maxVotes being their number.
+ */
+int houghUpdatePointVotes(int x, int y, const HoughTrigTable & table, int rhoOffset, cv::Mat & votes, int sign, int & maxVotes) {
+    int bias = (rhoOffset << HOUGH_TRIG_SHIFT) + (1 << (HOUGH_TRIG_SHIFT - 1));
+    int bestTheta = -1;
+    maxVotes = 0;
+    for (int t = 0; t < table.numTheta; ++t) {
+        int rhoIdx = (x * table.cosTable[t] + y * table.sinTable[t] + bias) >> HOUGH_TRIG_SHIFT;
+        int & count = votes.ptr<int>(t)[rhoIdx];
+        count += sign;
+        if (count > maxVotes) {
+            maxVotes = count;
+            bestTheta = t;
+        }
+    }
+    return bestTheta;
+}
+
+/**
+ * Progressive probabilistic Hough transform: finds line segments instead of infinite lines.
+ *
+ * Edge points vote one at a time, in random order. As soon as a bin reaches minVotes the line is walked
+ * on the edge map from the last voter in both directions, bridging gaps of up to maxLineGap pixels. The
+ * edge pixels of the walk are removed from further voting (the votes of those that already voted are
+ * taken back), and the walk becomes a segment if it is at least minLineLength long. Most edge pixels of a
+ * strong line never vote, which cuts the voting work on dense edge maps.
+ *
+ * @param edgePoints    Edge points, in image coordinates.
+ * @param imgSize       Size of the image.
+ * @param table         Trig table of the theta bins.
+ * @param minVotes      Votes a bin needs to trigger the extraction of a segment.
+ * @param minLineLength Minimum length of a segment, in pixels.
+ * @param maxLineGap    Maximum gap between two edge pixels of the same segment, in pixels.
+ * @param segments      Output segments as (x1, y1, x2, y2).
+ * @param maxSegments   Stop after this many segments (default is 0, no limit).
+ * @param seed          Seed of the random voting order.
+ */
+void houghLineSegments(const std::vector<EdgePoint> & edgePoints, cv::Size imgSize, const HoughTrigTable & table, int minVotes,
+                       int minLineLength, int maxLineGap, std::vector<cv::Vec4i> & segments, int maxSegments = 0,
+                       uint64 seed = 0x12345678) {
+    int rhoOffset = houghRhoOffset(imgSize);
+    CV_Assert(2 * rhoOffset + 1 < (INT_MAX >> HOUGH_TRIG_SHIFT));
+    cv::Mat votes = cv::Mat::zeros(table.numTheta, 2 * rhoOffset + 1, CV_32S);
+    segments.clear();
+
+    // Step 1: Edge map with the state of each pixel, and the random voting order.
+    cv::Mat state = cv::Mat::zeros(imgSize, CV_8U);
+    for (const EdgePoint & edge : edgePoints)
+        state.at<uchar>(edge.y, edge.x) = HOUGH_PIXEL_PENDING;
+    std::vector<int> order(edgePoints.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = (int) i;
+    cv::RNG rng(seed);
+    for (int i = (int) order.size() - 1; i > 0; --i)
+        std::swap(order[i], order[rng.uniform(0, i + 1)]);
+
+    for (int idx : order) {
+        int x = edgePoints[idx].x, y = edgePoints[idx].y;
+        uchar & pixelState = state.at<uchar>(y, x);
+        if (pixelState != HOUGH_PIXEL_PENDING)
+            continue;
+
+        // Step 2: Vote, and go on with the next point until a bin reaches the threshold.
+        pixelState = HOUGH_PIXEL_VOTED;
+        int maxVotes;
+        int theta = houghUpdatePointVotes(x, y, table, rhoOffset, votes, 1, maxVotes);
+        if (maxVotes < minVotes)
+            continue;
+
+        // Step 3: Walk the line through the point in both directions, one pixel per step along its
+        // major axis, until a gap longer than maxLineGap.
+        double dx = -std::sin(houghTheta(theta, table.numTheta));
+        double dy = std::cos(houghTheta(theta, table.numTheta));
+        double stepScale = 1.0 / std::max(std::abs(dx), std::abs(dy));
+        dx *= stepScale;
+        dy *= stepScale;
+
+        cv::Point lineEnd[2];
+        int steps[2];
+        for (int side = 0; side < 2; ++side) {
+            double sign = side == 0 ? 1.0 : -1.0;
+            lineEnd[side] = cv::Point(x, y);
+            steps[side] = 0;
+            for (int step = 1, gap = 0; ; ++step) {
+                int px = cvRound(x + sign * step * dx), py = cvRound(y + sign * step * dy);
+                if (px < 0 or px >= imgSize.width or py < 0 or py >= imgSize.height)
+                    break;
+                if (state.at<uchar>(py, px) != HOUGH_PIXEL_FREE) {
+                    lineEnd[side] = cv::Point(px, py);
+                    steps[side] = step;
+                    gap = 0;
+                } else if (++gap > maxLineGap) {
+                    break;
+                }
+            }
+        }
+
+        bool isLong = std::max(std::abs(lineEnd[0].x - lineEnd[1].x), std::abs(lineEnd[0].y - lineEnd[1].y)) >= minLineLength;
+
+        // Step 4: Remove the pixels of the walk from the edge map, taking back their votes if the
+        // segment is kept.
+        for (int side = 0; side < 2; ++side) {
+            double sign = side == 0 ? 1.0 : -1.0;
+            for (int step = side; step <= steps[side]; ++step) {
+                int px = cvRound(x + sign * step * dx), py = cvRound(y + sign * step * dy);
+                uchar & walkState = state.at<uchar>(py, px);
+                if (isLong and walkState == HOUGH_PIXEL_VOTED) {
+                    int unused;
+                    houghUpdatePointVotes(px, py, table, rhoOffset, votes, -1, unused);
+                }
+                walkState = HOUGH_PIXEL_FREE;
+            }
+        }
+
+        if (isLong) {
+            segments.emplace_back(lineEnd[0].x, lineEnd[0].y, lineEnd[1].x, lineEnd[1].y);
+            if (maxSegments > 0 and (int) segments.size() >= maxSegments)
+                break;
+        }
+    }
+}
+
+/**
+ * @struct HoughCircle
+ * @brief A circle found by the Hough transform.
+ */
+struct HoughCircle {
+    cv::Point center;
+    int radius;
+    int votes;      // Votes of the accumulator bin.
+};
+
+/**
+ * Returns the integer offsets (dx, dy) of the pixels of a digital circle of the given radius, built with
+ * the midpoint circle algorithm: every pixel of the 8-connected ring appears exactly once, so an edge point
+ * votes each center at that radius once, with no trigonometry in the voting loop.
+ *
+ * The tables are cached across calls; the returned reference stays valid (and is safe to read from several
+ * threads) for the lifetime of the program.
+ *
+ * @param radius Radius of the circle (>= 0).
+ *
+ * @return The offsets, sorted by row then column.
+ */
+const std::vector<cv::Point> & houghCircleOffsets(int radius) {
+    static std::mutex cacheMutex;
+    static std::map<int, std::vector<cv::Point>> cache;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto cached = cache.find(radius);
+    if (cached != cache.end())
+        return cached->second;
+
+    // Walk the octant from (0, radius) to the diagonal and mirror it in the other seven.
+    std::vector<cv::Point> offsets;
+    int x = 0, y = radius, decision = 1 - radius;
+    while (x <= y) {
+        cv::Point octant[8] = {{x, y}, {y, x}, {-x, y}, {-y, x}, {x, -y}, {y, -x}, {-x, -y}, {-y, -x}};
+        offsets.insert(offsets.end(), octant, octant + 8);
+        ++x;
+        if (decision < 0) {
+            decision += 2 * x + 1;
+        } else {
+            --y;
+            decision += 2 * (x - y) + 1;
+        }
+    }
+
+    // The points on the axes and on the diagonals are mirrored onto themselves.
+    std::sort(offsets.begin(), offsets.end(), [](const cv::Point & a, const cv::Point & b) {
+        return a.y < b.y or (a.y == b.y and a.x < b.x);
+    });
+    offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+
+    return cache.emplace(radius, std::move(offsets)).first->second;
+}
+
+/**
+ * Votes the centers of the circles of radius radiusBegin .. radiusBegin + numRadii - 1 through the edge
+ * points. The accumulator is a stack of numRadii 2D slices of imgSize (slice i is rows
+ * [i * height, (i + 1) * height)), so a band of radii only needs O(W * H * numRadii) memory.
+ *
+ * The slices are voted in parallel: each thread owns the slices of its radii, so no atomics or reduction
+ * are needed and the result does not depend on the number of threads.
+ *
+ * @param edgePoints  Edge points, in image coordinates.
+ * @param imgSize     Size of the image.
+ * @param radiusBegin First radius of the band.
+ * @param numRadii    Number of radii of the band.
+ * @param votes       Accumulator (CV_32S), reused across bands when it already has the right size.
+ */
+void houghVoteCircles(const std::vector<EdgePoint> & edgePoints, cv::Size imgSize, int radiusBegin, int numRadii, cv::Mat & votes) {
+    votes.create(numRadii * imgSize.height, imgSize.width, CV_32S);
+
+    cv::parallel_for_(cv::Range(0, numRadii), [&](const cv::Range & range) {
+        for (int i = range.start; i < range.end; ++i) {
+            const std::vector<cv::Point> & offsets = houghCircleOffsets(radiusBegin + i);
+            cv::Mat slice = votes.rowRange(i * imgSize.height, (i + 1) * imgSize.height);
+            slice.setTo(0);
+
+            for (const EdgePoint & edge : edgePoints) {
+                for (const cv::Point & offset : offsets) {
+                    int alpha = edge.x - offset.x, beta = edge.y - offset.y;
+                    if (alpha >= 0 and alpha < imgSize.width and beta >= 0 and beta < imgSize.height)
+                        slice.ptr<int>(beta)[alpha]++;
+                }
+            }
+        }
+    });
+}
+
+/**
+ * Vote threshold of a radius for a threshold given as a fraction of the circle: a full circle of radius r
+ * gets at most houghCircleOffsets(r).size() votes (about 5.7 * r), one per pixel of its digital ring, so an
+ * absolute threshold that suits large radii can never be reached by small ones.
+ *
+ * @param radius       Radius of the circle.
+ * @param voteFraction Fraction of the ring pixels that must vote a center (0 .. 1].
+ *
+ * @return The threshold on the votes of the radius (a center needs more votes than that).
+ */
+int houghCircleVoteThreshold(int radius, double voteFraction) {
+    return (int) (voteFraction * houghCircleOffsets(radius).size());
+}
+
+/**
+ * Peak extraction of houghCirclePeaks with the threshold of every slice given by thresholdOf(radius).
+ */
+template <typename Threshold>
+void houghCirclePeaksT(const cv::Mat & votes, cv::Size imgSize, int radiusBegin, Threshold thresholdOf, std::vector<HoughCircle> & circles) {
+    int numRadii = votes.rows / imgSize.height;
+    std::vector<std::vector<HoughCircle>> slicePeaks(numRadii);
+    cv::parallel_for_(cv::Range(0, numRadii), [&](const cv::Range & range) {
+        for (int i = range.start; i < range.end; ++i) {
+            cv::Mat slice = votes.rowRange(i * imgSize.height, (i + 1) * imgSize.height);
+            int houghTH = thresholdOf(radiusBegin + i);
+            for (int beta = 0; beta < imgSize.height; ++beta) {
+                const int * votesRow = slice.ptr<int>(beta);
+                for (int alpha = 0; alpha < imgSize.width; ++alpha) {
+                    int count = votesRow[alpha];
+                    if (count <= houghTH)
+                        continue;
+
+                    bool isPeak = true;
+                    for (int nb = std::max(beta - 1, 0); nb <= std::min(beta + 1, imgSize.height - 1) and isPeak; ++nb) {
+                        const int * neighRow = slice.ptr<int>(nb);
+                        for (int na = std::max(alpha - 1, 0); na <= std::min(alpha + 1, imgSize.width - 1); ++na) {
+                            bool isBefore = nb < beta or (nb == beta and na < alpha);
+                            if (neighRow[na] > count or (isBefore and neighRow[na] == count)) {
+                                isPeak = false;
+                                break;
+                            }
+                        }
+                    }
+
+                    if (isPeak)
+                        slicePeaks[i].push_back({cv::Point(alpha, beta), radiusBegin + i, count});
+                }
+            }
+        }
+    });
+
+    for (const std::vector<HoughCircle> & peaks : slicePeaks)
+        circles.insert(circles.end(), peaks.begin(), peaks.end());
+}
+
+/**
+ * Extracts the peaks of a band of circle accumulator slices: the centers with more than houghTH votes that
+ * are the maximum of their 3x3 neighbourhood in the slice (ties broken in scan order). The slices are
+ * scanned in parallel and their peaks appended in radius order.
+ *
+ * @param votes       Accumulator of houghVoteCircles (or of houghVoteCircleCenters, with radiusBegin 0).
+ * @param imgSize     Size of the image.
+ * @param radiusBegin First radius of the band.
+ * @param houghTH     Threshold on the votes, the same for every radius.
+ * @param circles     Circles the peaks are appended to.
+ */
+void houghCirclePeaks(const cv::Mat & votes, cv::Size imgSize, int radiusBegin, int houghTH, std::vector<HoughCircle> & circles) {
+    houghCirclePeaksT(votes, imgSize, radiusBegin, [houghTH](int) { return houghTH; }, circles);
+}
+
+/**
+ * Extracts the peaks of a band of circle accumulator slices, see houghCirclePeaks, with a threshold relative
+ * to the size of each circle: a center of radius r needs more than houghCircleVoteThreshold(r, voteFraction)
+ * votes, i.e. more than voteFraction of its ring must be edges.
+ *
+ * @param votes        Accumulator of houghVoteCircles.
+ * @param imgSize      Size of the image.
+ * @param radiusBegin  First radius of the band.
+ * @param voteFraction Fraction of the ring pixels that must vote a center (0 .. 1].
+ * @param circles      Circles the peaks are appended to.
+ */
+void houghCirclePeaksFraction(const cv::Mat & votes, cv::Size imgSize, int radiusBegin, double voteFraction, std::vector<HoughCircle> & circles) {
+    houghCirclePeaksT(votes, imgSize, radiusBegin, [voteFraction](int radius) {
+        return houghCircleVoteThreshold(radius, voteFraction);
+    }, circles);
+}
+
+/**
+ * Greedy non-maximum suppression of circles: going from the most voted, a circle is dropped when a kept
+ * circle has its center within centerDist pixels and its radius within radiusDist (the same circle found
+ * in adjacent slices or bands, or from a neighbouring center).
+ *
+ * @param circles    Circles, replaced by the kept ones sorted by decreasing votes.
+ * @param centerDist Maximum center difference of two duplicates, on each axis.
+ * @param radiusDist Maximum radius difference of two duplicates.
+ */
+void houghSuppressCircles(std::vector<HoughCircle> & circles, int centerDist, int radiusDist) {
+    std::stable_sort(circles.begin(), circles.end(), [](const HoughCircle & a, const HoughCircle & b) {
+        return a.votes > b.votes;
+    });
+
+    std::vector<HoughCircle> kept;
+    for (const HoughCircle & circle : circles) {
+        bool isDuplicate = false;
+        for (const HoughCircle & other : kept) {
+            if (std::abs(circle.center.x - other.center.x) <= centerDist and std::abs(circle.center.y - other.center.y) <= centerDist
+                and std::abs(circle.radius - other.radius) <= radiusDist) {
+                isDuplicate = true;
+                break;
+            }
+        }
+        if (not isDuplicate)
+            kept.push_back(circle);
+    }
+    circles.swap(kept);
+}
+
+/**
+ * First stage of the gradient-directed Hough transform for circles: every edge point votes the centers
+ * along its gradient direction, in both signs, at distance radiusMin .. radiusMax. The accumulator is a
+ * single 2D slice of the image size and each point votes O(R) bins instead of O(360 * R).
+ *
+ * @param edgePoints Edge points, in image coordinates.
+ * @param gradients  Gradient of each edge point, see houghEdgeGradients.
+ * @param imgSize    Size of the image.
+ * @param radiusMin  Minimum radius.
+ * @param radiusMax  Maximum radius.
+ * @param votes      Output accumulator of the centers (CV_32S).
+ */
+void houghVoteCircleCenters(const std::vector<EdgePoint> & edgePoints, const std::vector<cv::Point> & gradients, cv::Size imgSize,
+                            int radiusMin, int radiusMax, cv::Mat & votes) {
+    votes.create(imgSize, CV_32S);
+    votes.setTo(0);
+
+    for (size_t i = 0; i < edgePoints.size(); ++i) {
+        double norm = std::hypot((double) gradients[i].x, (double) gradients[i].y);
+        if (norm == 0)
+            continue;
+        double ux = gradients[i].x / norm, uy = gradients[i].y / norm;
+
+        for (int sign = -1; sign <= 1; sign += 2) {
+            // Consecutive radii can round to the same center: it gets a single vote from the point.
+            int lastAlpha = -1, lastBeta = -1;
+            for (int radius = radiusMin; radius <= radiusMax; ++radius) {
+                int alpha = cvRound(edgePoints[i].x + sign * radius * ux);
+                int beta = cvRound(edgePoints[i].y + sign * radius * uy);
+                if (alpha < 0 or alpha >= imgSize.width or beta < 0 or beta >= imgSize.height)
+                    break;
+                if (alpha != lastAlpha or beta != lastBeta)
+                    votes.ptr<int>(beta)[alpha]++;
+                lastAlpha = alpha;
+                lastBeta = beta;
+            }
+        }
+    }
+}
+
+/**
+ * Second stage of the gradient-directed Hough transform for circles: estimates the radius of a center from
+ * the histogram of the distances of the edge points. Only the rows within radiusMax of the center are
+ * scanned, found by binary search since the edge points are in scan order. The support of a radius counts
+ * the edge points at +-1 pixel too, so that a center found one pixel off still collects its circle.
+ *
+ * @param edgePoints Edge points, in scan order.
+ * @param center     Center of the circle.
+ * @param radiusMin  Minimum radius.
+ * @param radiusMax  Maximum radius.
+ * @param histogram  Scratch radius histogram, reused across centers.
+ *
+ * @return The radius with the largest support, votes being the number of supporting edge points.
+ */
+HoughCircle houghEstimateRadius(const std::vector<EdgePoint> & edgePoints, cv::Point center, int radiusMin, int radiusMax,
+                                std::vector<int> & histogram) {
+    CV_Assert(radiusMin >= 1);
+    histogram.assign(radiusMax + 2, 0);
+    auto byRow = [](const EdgePoint & edge, int y) { return edge.y < y; };
+    auto first = std::lower_bound(edgePoints.begin(), edgePoints.end(), center.y - radiusMax - 1, byRow);
+    for (auto edge = first; edge != edgePoints.end() and edge->y <= center.y + radiusMax + 1; ++edge) {
+        int dx = edge->x - center.x, dy = edge->y - center.y;
+        if (std::abs(dx) > radiusMax + 1)
+            continue;
+        int distance = cvRound(std::sqrt((double) (dx * dx + dy * dy)));
+        if (distance >= radiusMin - 1 and distance <= radiusMax + 1)
+            histogram[distance]++;
+    }
+
+    HoughCircle circle = {center, radiusMin, 0};
+    for (int radius = radiusMin; radius <= radiusMax; ++radius) {
+        int support = histogram[radius - 1] + histogram[radius] + histogram[radius + 1];
+        if (support > circle.votes) {
+            circle.radius = radius;
+            circle.votes = support;
+        }
+    }
+    return circle;
+}
+
+/**
+ * Reduces an edge map by an integer factor: a coarse pixel is an edge if any of its factor x factor pixels
+ * is an edge.
+ *
+ * @param edgePoints   Edge points, in image coordinates.
+ * @param imgSize      Size of the image.
+ * @param factor       Reduction factor.
+ * @param coarsePoints Output edge points of the reduced map, in scan order.
+ * @param coarseSize   Output size of the reduced map.
+ */
+void houghDownsampleEdges(const std::vector<EdgePoint> & edgePoints, cv::Size imgSize, int factor, std::vector<EdgePoint> & coarsePoints,
+                          cv::Size & coarseSize) {
+    coarseSize = cv::Size((imgSize.width + factor - 1) / factor, (imgSize.height + factor - 1) / factor);
+    cv::Mat coarseMask = cv::Mat::zeros(coarseSize, CV_8U);
+    for (const EdgePoint & edge : edgePoints)
+        coarseMask.at<uchar>(edge.y / factor, edge.x / factor) = 1;
+
+    coarsePoints.clear();
+    for (int y = 0; y < coarseSize.height; ++y) {
+        const uchar * maskRow = coarseMask.ptr<uchar>(y);
+        for (int x = 0; x < coarseSize.width; ++x) {
+            if (maskRow[x])
+                coarsePoints.push_back({x, y, EDGE_DIR_0, 0});
+        }
+    }
+}
+
+/**
+ * Refines a circle at full resolution: searches the centers within searchRadius pixels and the radii within
+ * searchRadius of the given circle for the one with the most votes. The votes of a (center, radius) are
+ * counted directly on the edge mask along the offsets of the radius, which gives the same count as the
+ * full accumulator of houghVoteCircles without building it.
+ *
+ * @param edgeMask     Edge map (CV_8U, non-zero on the edges).
+ * @param circle       Circle to refine, in full resolution coordinates.
+ * @param searchRadius Half-width of the search window, for the center and the radius.
+ * @param radiusMin    Minimum radius.
+ * @param radiusMax    Maximum radius.
+ *
+ * @return The best circle of the window.
+ */
+HoughCircle houghRefineCircle(const cv::Mat & edgeMask, const HoughCircle & circle, int searchRadius, int radiusMin, int radiusMax) {
+    HoughCircle best = {circle.center, circle.radius, -1};
+    int radiusBegin = std::max(circle.radius - searchRadius, radiusMin);
+    int radiusEnd = std::min(circle.radius + searchRadius, radiusMax);
+    for (int radius = radiusBegin; radius <= radiusEnd; ++radius) {
+        const std::vector<cv::Point> & offsets = houghCircleOffsets(radius);
+        for (int beta = std::max(circle.center.y - searchRadius, 0); beta <= std::min(circle.center.y + searchRadius, edgeMask.rows - 1); ++beta) {
+            for (int alpha = std::max(circle.center.x - searchRadius, 0); alpha <= std::min(circle.center.x + searchRadius, edgeMask.cols - 1); ++alpha) {
+                int count = 0;
+                for (const cv::Point & offset : offsets) {
+                    int x = alpha + offset.x, y = beta + offset.y;
+                    if (x >= 0 and x < edgeMask.cols and y >= 0 and y < edgeMask.rows and edgeMask.ptr<uchar>(y)[x])
+                        count++;
+                }
+                if (count > best.votes)
+                    best = {cv::Point(alpha, beta), radius, count};
+            }
+        }
+    }
+    return best;
+}
+
+/**
+ * Draws circles found by the Hough transform.
+ *
+ * @param img       Image to draw on.
+ * @param circles   Circles to draw.
+ * @param color     Color of the circles.
+ * @param thickness Thickness of the circles.
+ */
+void houghDrawCircles(cv::Mat & img, const std::vector<HoughCircle> & circles, const cv::Scalar & color, int thickness = 2) {
+    for (const HoughCircle & circle : circles)
+        cv::circle(img, circle.center, circle.radius, color, thickness, 8);
+}
+
+#endif //OPENCVELIM_HOUGH_H
@@ -0,0 +1,498 @@
+#ifndef OPENCVELIM_OTSU_H
+#define OPENCVELIM_OTSU_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "histogram.h"
+
+// Maximum number of gray levels the multi-level search runs on: wider histograms (16 bit) are reduced to it.
+#define OTSU_MAX_LEVELS 4096
+
+/**
+ * Reduces an integer histogram to the levels the threshold search runs on: trailing empty bins are
+ * dropped (12 bit data stored in 16 bit pixels keeps 4096 levels) and, while more than maxLevels remain,
+ * pairs of adjacent bins are merged. The result is normalized.
+ *
+ * @param hist      Input histogram (counts).
+ * @param maxLevels Maximum number of output levels.
+ * @param levels    Output normalized histogram; level l holds the bins [l << shift, (l + 1) << shift).
+ *
+ * @return The shift mapping a pixel value to its level (value >> shift).
+ */
+int otsuReduceHistogram(const std::vector<int> & hist, int maxLevels, std::vector<double> & levels) {
+    int numBins = (int) hist.size();
+    while (numBins > 1 and hist[numBins - 1] == 0)
+        numBins--;
+
+    int shift = 0;
+    while (((numBins - 1) >> shift) + 1 > maxLevels)
+        shift++;
+
+    double numPixels = 0.0;
+    levels.assign(((numBins - 1) >> shift) + 1, 0.0);
+    for (int bin = 0; bin < numBins; ++bin) {
+        levels[bin >> shift] += hist[bin];
+        numPixels += hist[bin];
+    }
+    for (double & level : levels)
+        level /= numPixels;
+
+    return shift;
+}
+
+/**
+ * Computes Otsu's threshold of a normalized histogram: the level k maximizing the between-class variance
+ * (mG * P1 - m)^2 / (P1 * (1 - P1)) of the classes [0, k] and [k + 1, L).
+ *
+ * @param histogram Normalized histogram.
+ *
+ * @return The optimal threshold (last level of the background).
+ */
+int otsuThreshold(const std::vector<double> & histogram) {
+    double globalCumulativeMean = 0.0;
+    for (int i = 0; i < (int) histogram.size(); ++i)
+        globalCumulativeMean += i * histogram[i];
+
+    double probability = 0.0, cumulativeMean = 0.0, maxVariance = 0.0;
+    int optimalTH = 0;
+    for (int k = 0; k < (int) histogram.size(); ++k) {
+        probability += histogram[k];
+        cumulativeMean += k * histogram[k];
+
+        double denominator = probability * (1.0 - probability);
+        if (denominator <= 0.0)
+            continue;
+        double betweenClassesVariance = std::pow(globalCumulativeMean * probability - cumulativeMean, 2) / denominator;
+        if (betweenClassesVariance > maxVariance) {
+            maxVariance = betweenClassesVariance;
+            optimalTH = k;
+        }
+    }
+    return optimalTH;
+}
+
+/**
+ * Gaussian blur fused with binary thresholding for rows [rowBegin, rowEnd) of an 8 bit image: out is
+ * 255 where the blurred pixel (rounded like cv::GaussianBlur on 8 bit images) is > its threshold, 0 elsewhere.
+ *
+ * The blur is separable: each input row is filtered horizontally into a ring of blurSize float rows and
+ * each output row is the vertical filtering of the ring, thresholded and written once. Neither the blurred
+ * image nor any other full-size intermediate exists; rows outside the range are read as halo, so bands
+ * can be processed independently. Borders are reflected (BORDER_REFLECT_101) like in cv::GaussianBlur.
+ *
+ * @param img          Input image (CV_8U, single channel).
+ * @param rowBegin     First row to compute.
+ * @param rowEnd       One past the last row to compute.
+ * @param gauss        1D Gaussian kernel (odd size), applied on both axes.
+ * @param thresholdRow Called with a row index, returns the thresholds of the pixels of that row.
+ * @param out          Output image (CV_8U, same size as img), only rows [rowBegin, rowEnd) are written.
+ */
+template<typename ThresholdRow>
+void otsuBlurThresholdRows(const cv::Mat & img, int rowBegin, int rowEnd, const std::vector<float> & gauss,
+                           ThresholdRow thresholdRow, cv::Mat & out) {
+    int rows = img.rows, cols = img.cols;
+    int blurSize = (int) gauss.size(), half = blurSize / 2;
+
+    // Source column of every padded position, reflected at the borders.
+    std::vector<int> columns(cols + 2 * half);
+    for (int x = 0; x < cols + 2 * half; ++x)
+        columns[x] = cv::borderInterpolate(x - half, cols, cv::BORDER_REFLECT_101);
+
+    std::vector<float> padded(cols + 2 * half);
+    std::vector<float> ring((size_t) blurSize * cols);
+    std::vector<float> blurred(cols);
+
+    // Filters image row y horizontally into ring slot y % blurSize.
+    auto filterRow = [&](int y) {
+        const uchar * src = img.ptr<uchar>(y);
+        for (int x = 0; x < cols + 2 * half; ++x)
+            padded[x] = src[columns[x]];
+
+        float * slot = &ring[(size_t) (y % blurSize) * cols];
+        std::fill(slot, slot + cols, 0.f);
+        for (int i = 0; i < blurSize; ++i) {
+            const float * shifted = &padded[i];
+            float coefficient = gauss[i];
+            for (int x = 0; x < cols; ++x)
+                slot[x] += coefficient * shifted[x];
+        }
+    };
+
+    int nextRow = std::max(rowBegin - half, 0);
+    for (int y = rowBegin; y < rowEnd; ++y) {
+        // Make sure the ring holds every row of the vertical window.
+        while (nextRow <= std::min(y + half, rows - 1))
+            filterRow(nextRow++);
+
+        std::fill(blurred.begin(), blurred.end(), 0.f);
+        for (int i = 0; i < blurSize; ++i) {
+            int srcRow = cv::borderInterpolate(y + i - half, rows, cv::BORDER_REFLECT_101);
+            const float * slot = &ring[(size_t) (srcRow % blurSize) * cols];
+            float coefficient = gauss[i];
+            for (int x = 0; x < cols; ++x)
+                blurred[x] += coefficient * slot[x];
+        }
+
+        const float * thresholds = thresholdRow(y);
+        uchar * outRow = out.ptr<uchar>(y);
+        for (int x = 0; x < cols; ++x)
+            outRow[x] = cvRound(blurred[x]) > thresholds[x] ? 255 : 0;
+    }
+}
+
+/**
+ * otsuBlurThresholdRows with the same threshold for every pixel.
+ *
+ * @param img       Input image (CV_8U, single channel).
+ * @param rowBegin  First row to compute.
+ * @param rowEnd    One past the last row to compute.
+ * @param gauss     1D Gaussian kernel (odd size), applied on both axes.
+ * @param threshold Threshold applied to the blurred values.
+ * @param out       Output image (CV_8U, same size as img), only rows [rowBegin, rowEnd) are written.
+ */
+void otsuBlurThresholdRows(const cv::Mat & img, int rowBegin, int rowEnd, const std::vector<float> & gauss, int threshold, cv::Mat & out) {
+    std::vector<float> thresholds(img.cols, (float) threshold);
+    otsuBlurThresholdRows(img, rowBegin, rowEnd, gauss, [&](int) { return thresholds.data(); }, out);
+}
+
+/**
+ * Computes the Otsu threshold of every tile of a grid in one pass: the tiles are histogrammed in parallel
+ * and their histograms are summed into the global one for free. Tiles with a single gray level (nothing
+ * to split) get the global threshold.
+ *
+ * @param img            Input image (CV_8U, single channel).
+ * @param tilesX         Number of tile columns.
+ * @param tilesY         Number of tile rows.
+ * @param tileThresholds Output thresholds (CV_32F, tilesY x tilesX).
+ *
+ * @return The global threshold.
+ */
+int otsuTileThresholds(const cv::Mat & img, int tilesX, int tilesY, cv::Mat & tileThresholds) {
+    CV_Assert(img.type() == CV_8U);
+    int numTiles = tilesX * tilesY;
+    std::vector<std::vector<int>> tileHists(numTiles);
+    std::vector<int> tileLevels(numTiles, 0);
+    cv::parallel_for_(cv::Range(0, numTiles), [&](const cv::Range & range) {
+        for (int tile = range.start; tile < range.end; ++tile) {
+            int tx = tile % tilesX, ty = tile / tilesX;
+            cv::Rect rect(tx * img.cols / tilesX, ty * img.rows / tilesY,
+                          (tx + 1) * img.cols / tilesX - tx * img.cols / tilesX,
+                          (ty + 1) * img.rows / tilesY - ty * img.rows / tilesY);
+            computeHistogram(cv::Mat(img, rect), tileHists[tile]);
+            tileLevels[tile] = (int) std::count_if(tileHists[tile].begin(), tileHists[tile].end(), [](int n) { return n > 0; });
+        }
+    });
+
+    std::vector<double> histogram(HISTOGRAM_BINS, 0.0);
+    for (const std::vector<int> & tileHist : tileHists)
+        for (int bin = 0; bin < HISTOGRAM_BINS; ++bin)
+            histogram[bin] += tileHist[bin];
+    for (double & bin : histogram)
+        bin /= img.total();
+    int globalTH = otsuThreshold(histogram);
+
+    tileThresholds.create(tilesY, tilesX, CV_32F);
+    cv::parallel_for_(cv::Range(0, numTiles), [&](const cv::Range & range) {
+        for (int tile = range.start; tile < range.end; ++tile) {
+            int tileTH = globalTH;
+            if (tileLevels[tile] > 1) {
+                int tilePixels = 0;
+                for (int n : tileHists[tile])
+                    tilePixels += n;
+                std::vector<double> tileHistogram(tileHists[tile].begin(), tileHists[tile].end());
+                for (double & bin : tileHistogram)
+                    bin /= tilePixels;
+                tileTH = otsuThreshold(tileHistogram);
+            }
+            tileThresholds.at<float>(tile / tilesX, tile % tilesX) = (float) tileTH;
+        }
+    });
+    return globalTH;
+}
+
+/**
+ * Bilinearly interpolates the tile thresholds between the tile centers (CLAHE-style) for one image row.
+ * Outside the outermost centers the nearest tiles are used.
+ *
+ * @param tileThresholds Tile thresholds (CV_32F, tilesY x tilesX) from otsuTileThresholds.
+ * @param imgSize        Size of the image.
+ * @param y              Image row.
+ * @param row            Output thresholds of the imgSize.width pixels of the row.
+ */
+void otsuInterpolateThresholdRow(const cv::Mat & tileThresholds, cv::Size imgSize, int y, float * row) {
+    int tilesX = tileThresholds.cols, tilesY = tileThresholds.rows;
+
+    // Tile centers are at (t + 0.5) * size / tiles: position of the pixel in tile units from the first center.
+    float fy = std::min(std::max((y + 0.5f) * tilesY / imgSize.height - 0.5f, 0.f), (float) (tilesY - 1));
+    int y0 = (int) fy, y1 = std::min(y0 + 1, tilesY - 1);
+    float wy = fy - y0;
+    const float * top = tileThresholds.ptr<float>(y0);
+    const float * bottom = tileThresholds.ptr<float>(y1);
+
+    for (int x = 0; x < imgSize.width; ++x) {
+        float fx = std::min(std::max((x + 0.5f) * tilesX / imgSize.width - 0.5f, 0.f), (float) (tilesX - 1));
+        int x0 = (int) fx, x1 = std::min(x0 + 1, tilesX - 1);
+        float wx = fx - x0;
+        float topTH = top[x0] + wx * (top[x1] - top[x0]);
+        float bottomTH = bottom[x0] + wx * (bottom[x1] - bottom[x0]);
+        row[x] = topTH + wy * (bottomTH - topTH);
+    }
+}
+
+/**
+ * Score of the class made of the levels [begin, end): P * mi^2 = (sum of l * p(l))^2 / (sum of p(l)).
+ * Since the global mean is fixed, maximizing the sum of the class scores maximizes the between-class variance.
+ *
+ * @param prob    Prefix sums of the histogram (prob[l] = p(0) + ... + p(l - 1)).
+ * @param cumMean Prefix sums of the first moment (cumMean[l] = 0 * p(0) + ... + (l - 1) * p(l - 1)).
+ * @param begin   First level of the class.
+ * @param end     One past the last level of the class.
+ *
+ * @return The score of the class, 0 for an empty class.
+ */
+inline double otsuClassScore(const std::vector<double> & prob, const std::vector<double> & cumMean, int begin, int end) {
+    double p = prob[end] - prob[begin];
+    double m = cumMean[end] - cumMean[begin];
+    return p > 0.0 ? m * m / p : 0.0;
+}
+
+/**
+ * Fills the scores of the best splits of the levels [0, end) into c classes for end in [endBegin, endEnd),
+ * with divide and conquer: the start of the last class of the best split never moves left when end grows,
+ * so the middle end is solved first and bounds the start candidates of the two halves.
+ *
+ * @param prevScore  Best scores with c - 1 classes, indexed by end.
+ * @param score      Output best scores with c classes.
+ * @param choice     Output start of the last class of each best split.
+ * @param prob       Prefix sums of the histogram.
+ * @param cumMean    Prefix sums of the first moment.
+ * @param c          Number of classes.
+ * @param endBegin   First end to solve.
+ * @param endEnd     One past the last end to solve.
+ * @param startBegin First candidate start of the last class.
+ * @param startEnd   Last candidate start of the last class.
+ */
+void otsuSolveClasses(const std::vector<double> & prevScore, std::vector<double> & score, int * choice,
+                      const std::vector<double> & prob, const std::vector<double> & cumMean,
+                      int c, int endBegin, int endEnd, int startBegin, int startEnd) {
+    if (endBegin >= endEnd)
+        return;
+
+    int end = (endBegin + endEnd) / 2;
+    int bestStart = std::max(startBegin, c - 1);
+    double bestScore = -1.0;
+    for (int start = bestStart; start <= std::min(startEnd, end - 1); ++start) {
+        double currentScore = prevScore[start] + otsuClassScore(prob, cumMean, start, end);
+        if (currentScore > bestScore) {
+            bestScore = currentScore;
+            bestStart = start;
+        }
+    }
+    score[end] = bestScore;
+    choice[end] = bestStart;
+
+    otsuSolveClasses(prevScore, score, choice, prob, cumMean, c, endBegin, end, startBegin, bestStart);
+    otsuSolveClasses(prevScore, score, choice, prob, cumMean, c, end + 1, endEnd, bestStart, startEnd);
+}
+
+/**
+ * Computes the numClasses - 1 thresholds maximizing the between-class variance of a histogram.
+ *
+ * Dynamic programming over the prefix sums of the histogram and of its first moment: the best split of
+ * the levels [0, end) into c classes is the best split of [0, start) into c - 1 classes plus the class
+ * [start, end). Every layer is solved in O(L log L) with otsuSolveClasses, O(k * L log L) overall instead
+ * of the O(L^(k-1)) exhaustive search.
+ *
+ * @param histogram  Normalized histogram.
+ * @param numClasses Number of classes (2 gives Otsu's threshold, 3 the two thresholds of Otsu2k).
+ *
+ * @return The thresholds in increasing order: threshold i is the first level of class i + 1.
+ */
+std::vector<int> otsuMultilevelThresholds(const std::vector<double> & histogram, int numClasses) {
+    int numLevels = (int) histogram.size();
+    CV_Assert(numClasses >= 2 and numClasses <= numLevels);
+
+    std::vector<double> prob(numLevels + 1, 0.0);
+    std::vector<double> cumMean(numLevels + 1, 0.0);
+    for (int l = 0; l < numLevels; ++l) {
+        prob[l + 1] = prob[l] + histogram[l];
+        cumMean[l + 1] = cumMean[l] + l * histogram[l];
+    }
+
+    // One class: the levels [0, end) form a single class.
+    std::vector<double> prevScore(numLevels + 1, 0.0);
+    for (int end = 1; end <= numLevels; ++end)
+        prevScore[end] = otsuClassScore(prob, cumMean, 0, end);
+
+    // c classes need at least c levels: ends in [c, numLevels], last class starts in [c - 1, end - 1].
+    std::vector<double> score(numLevels + 1, 0.0);
+    std::vector<int> choices((numClasses - 1) * (numLevels + 1), 0);
+    for (int c = 2; c <= numClasses; ++c) {
+        int * choice = &choices[(c - 2) * (numLevels + 1)];
+        // The last layer only needs the split of all the levels.
+        int endBegin = c == numClasses ? numLevels : c;
+        otsuSolveClasses(prevScore, score, choice, prob, cumMean, c, endBegin, numLevels + 1, c - 1, numLevels - 1);
+        std::swap(prevScore, score);
+    }
+
+    // Walk the choices back from the split of all the levels.
+    std::vector<int> thresholds(numClasses - 1);
+    int end = numLevels;
+    for (int c = numClasses; c >= 2; --c) {
+        end = choices[(c - 2) * (numLevels + 1) + end];
+        thresholds[c - 2] = end;
+    }
+    return thresholds;
+}
+
+/**
+ * Maps every pixel to the gray level of its class through a lookup table: class c of k becomes
+ * c * 256 / (k - 1), saturated to 255 (0, 128, 255 for three classes).
+ *
+ * @param img        Input image (CV_8U or CV_16U, single channel).
+ * @param thresholds Thresholds from otsuMultilevelThresholds, in levels.
+ * @param shift      Shift mapping a pixel value to its level (from otsuReduceHistogram, 0 for 8 bit).
+ *
+ * @return The CV_8U image of the class gray levels.
+ */
+cv::Mat otsuApplyLevels(const cv::Mat & img, const std::vector<int> & thresholds, int shift = 0) {
+    CV_Assert(img.type() == CV_8U or img.type() == CV_16U);
+    int numClasses = (int) thresholds.size() + 1;
+    int lutSize = img.type() == CV_8U ? 256 : 65536;
+
+    cv::Mat lut(1, lutSize, CV_8U);
+    uchar * lutRow = lut.ptr<uchar>(0);
+    int c = 0;
+    for (int value = 0; value < lutSize; ++value) {
+        while (c < numClasses - 1 and (value >> shift) >= thresholds[c])
+            c++;
+        lutRow[value] = (uchar) std::min(255, c * 256 / (numClasses - 1));
+    }
+
+    cv::Mat out;
+    if (img.type() == CV_8U) {
+        cv::LUT(img, lut, out);
+        return out;
+    }
+
+    // cv::LUT only takes 8 bit input: 16 bit pixels index the table row by row.
+    out.create(img.size(), CV_8U);
+    for (int y = 0; y < img.rows; ++y) {
+        const ushort * imgRow = img.ptr<ushort>(y);
+        uchar * outRow = out.ptr<uchar>(y);
+        for (int x = 0; x < img.cols; ++x)
+            outRow[x] = lutRow[imgRow[x]];
+    }
+    return out;
+}
+
+/**
+ * @struct OtsuVideoState
+ * @brief State kept between the frames of a video by otsuUpdateVideo: the last frame the histogram was
+ * updated with, its histogram, the histogram the current threshold was searched on, and the number of
+ * frames seen (which sets the phase of the sampled comparison).
+ */
+struct OtsuVideoState {
+    cv::Mat previous;
+    std::vector<int> histogram;
+    std::vector<int> searched;
+    int threshold = 0;
+    int numSearches = 0;
+    int numFrames = 0;
+};
+
+/**
+ * Updates the Otsu threshold of a video stream with a new frame.
+ *
+ * Instead of rebuilding the histogram, the frame is compared with the stored one tile by tile: a tile is
+ * checked on one pixel every sampleStep rows and columns and, only when a sampled pixel changed, its
+ * pixels are moved from their old bins to their new ones and copied into the stored frame. The phase of
+ * the sampling grid rotates every frame, so every pixel is compared once every sampleStep^2 frames: a
+ * change missed by the sampling is picked up within sampleStep^2 frames, and since the histogram always
+ * describes the stored frame it never drifts (sampleStep = 1 makes the update exact).
+ * The threshold is searched again only when the histogram moved by more than maxShift (fraction of
+ * pixels that changed bin since the last search).
+ *
+ * @param frame      New frame (CV_8U, single channel).
+ * @param state      State of the stream, reset when the frame size changes.
+ * @param tileSize   Size of the tiles the change detection works on (default is 32).
+ * @param sampleStep Step of the sampled comparison in a tile (default is 4).
+ * @param maxShift   Histogram movement triggering a new threshold search (default is 0.01).
+ *
+ * @return The threshold of the frame (last level of the background).
+ */
+int otsuUpdateVideo(const cv::Mat & frame, OtsuVideoState & state, int tileSize = 32, int sampleStep = 4, double maxShift = 0.01) {
+    CV_Assert(frame.type() == CV_8U);
+    auto search = [&]() {
+        std::vector<double> histogram(state.histogram.begin(), state.histogram.end());
+        for (double & bin : histogram)
+            bin /= frame.total();
+        state.threshold = otsuThreshold(histogram);
+        state.searched = state.histogram;
+        state.numSearches++;
+    };
+
+    // First frame (or new size): full histogram.
+    if (state.previous.empty() or state.previous.size() != frame.size()) {
+        state.numFrames = 1;
+        state.previous = frame.clone();
+        computeHistogram(frame, state.histogram, cv::Mat(), cv::getNumThreads());
+        search();
+        return state.threshold;
+    }
+
+    // Offset of the sampling grid in this frame, cycling through the sampleStep^2 phases.
+    int phase = state.numFrames++ % (sampleStep * sampleStep);
+    int offsetY = phase / sampleStep, offsetX = phase % sampleStep;
+
+    int tilesX = (frame.cols + tileSize - 1) / tileSize;
+    int tilesY = (frame.rows + tileSize - 1) / tileSize;
+    std::vector<std::vector<int>> deltas(tilesX * tilesY);
+    cv::parallel_for_(cv::Range(0, tilesX * tilesY), [&](const cv::Range & range) {
+        for (int tile = range.start; tile < range.end; ++tile) {
+            int x0 = (tile % tilesX) * tileSize, x1 = std::min(x0 + tileSize, frame.cols);
+            int y0 = (tile / tilesX) * tileSize, y1 = std::min(y0 + tileSize, frame.rows);
+
+            // Sampled comparison with the stored frame.
+            bool changed = false;
+            for (int y = y0 + offsetY; y < y1 and not changed; y += sampleStep) {
+                const uchar * frameRow = frame.ptr<uchar>(y);
+                const uchar * previousRow = state.previous.ptr<uchar>(y);
+                for (int x = x0 + offsetX; x < x1 and not changed; x += sampleStep)
+                    changed = frameRow[x] != previousRow[x];
+            }
+            if (not changed)
+                continue;
+
+            // Move the pixels of the tile from their old bins to their new ones.
+            std::vector<int> & delta = deltas[tile];
+            delta.assign(HISTOGRAM_BINS, 0);
+            for (int y = y0; y < y1; ++y) {
+                const uchar * frameRow = frame.ptr<uchar>(y);
+                uchar * previousRow = state.previous.ptr<uchar>(y);
+                for (int x = x0; x < x1; ++x) {
+                    delta[previousRow[x]]--;
+                    delta[frameRow[x]]++;
+                    previousRow[x] = frameRow[x];
+                }
+            }
+        }
+    });
+
+    for (const std::vector<int> & delta : deltas)
+        for (int bin = 0; bin < (int) delta.size(); ++bin)
+            state.histogram[bin] += delta[bin];
+
+    // Search again only if the histogram moved enough since the last search.
+    long long moved = 0;
+    for (int bin = 0; bin < HISTOGRAM_BINS; ++bin)
+        moved += std::abs(state.histogram[bin] - state.searched[bin]);
+    if (moved > 2 * maxShift * frame.total())
+        search();
+
+    return state.threshold;
+}
+
+#endif //OPENCVELIM_OTSU_H